@@ -25,6 +25,17 @@ unsigned int gA2lComponents;
 unsigned int gA2lInstances;
 unsigned int gA2lConversions;
 
+// A2L name of the BUILD_CHECKSUM type
+#if defined(XCP_CHECKSUM_TYPE) && XCP_CHECKSUM_TYPE == XCP_CHECKSUM_TYPE_ADD14
+#define A2L_CHECKSUM_TYPE "XCP_ADD_14"
+#elif defined(XCP_CHECKSUM_TYPE) && XCP_CHECKSUM_TYPE == XCP_CHECKSUM_TYPE_CRC16CCITT
+#define A2L_CHECKSUM_TYPE "XCP_CRC_16_CITT"
+#elif defined(XCP_CHECKSUM_TYPE) && XCP_CHECKSUM_TYPE == XCP_CHECKSUM_TYPE_CRC32
+#define A2L_CHECKSUM_TYPE "XCP_CRC_32"
+#else
+#define A2L_CHECKSUM_TYPE "XCP_ADD_44"
+#endif
+
 static const char* gA2lHeader =
 "ASAP2_VERSION 1 71\n"
 "/begin PROJECT XCPlite \"\"\n"
@@ -43,9 +54,9 @@ static const char* gA2lHeader =
 "CALRAM \"\" DATA FLASH INTERN 0x%08X 0x%08X - 1 - 1 - 1 - 1 - 1\n" // CALRAM_START, CALRAM_SIZE
 "/begin IF_DATA XCP\n"
 "/begin SEGMENT 0x01 0x02 0x00 0x00 0x00 \n"
-"/begin CHECKSUM XCP_ADD_44 MAX_BLOCK_SIZE 0xFFFF EXTERNAL_FUNCTION \"\" /end CHECKSUM\n"
-"/begin PAGE 0x01 ECU_ACCESS_WITH_XCP_ONLY XCP_READ_ACCESS_WITH_ECU_ONLY XCP_WRITE_ACCESS_NOT_ALLOWED /end PAGE\n"
-"/begin PAGE 0x00 ECU_ACCESS_WITH_XCP_ONLY XCP_READ_ACCESS_WITH_ECU_ONLY XCP_WRITE_ACCESS_WITH_ECU_ONLY /end PAGE\n"
+"/begin CHECKSUM " A2L_CHECKSUM_TYPE " MAX_BLOCK_SIZE 0xFFFF EXTERNAL_FUNCTION \"\" /end CHECKSUM\n"
+"/begin PAGE 0x01 ECU_ACCESS_DONT_CARE XCP_READ_ACCESS_DONT_CARE XCP_WRITE_ACCESS_NOT_ALLOWED /end PAGE\n"
+"/begin PAGE 0x00 ECU_ACCESS_DONT_CARE XCP_READ_ACCESS_DONT_CARE XCP_WRITE_ACCESS_DONT_CARE /end PAGE\n"
 "/end SEGMENT\n"
 "/end IF_DATA\n"
 "/end MEMORY_SEGMENT\n"
@@ -64,6 +75,18 @@ static const char* gA2lHeader =
 "ALIGNMENT_INT64 1\n"
 "/end MOD_COMMON\n\n";
 
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+#define A2L_PRESCALER_SUPPORTED "PRESCALER_SUPPORTED\n"
+#else
+#define A2L_PRESCALER_SUPPORTED ""
+#endif
+
+#ifdef XCP_ENABLE_DAQ_HDR_ODT_FIL_DAQW
+#define A2L_IDENTIFICATION_FIELD_TYPE "IDENTIFICATION_FIELD_TYPE_RELATIVE_WORD_ALIGNED"
+#else
+#define A2L_IDENTIFICATION_FIELD_TYPE "IDENTIFICATION_FIELD_TYPE_RELATIVE_BYTE"
+#endif
+
 static const char* gA2lIfData1 = // Parameters %04X version, %u max cto, %u max dto, %u max event, %s timestamp unit
 "/begin IF_DATA XCP\n"
 
@@ -79,6 +102,9 @@ static const char* gA2lIfData1 = // Parameters %04X version, %u max cto, %u max
 "OPTIONAL_CMD UPLOAD\n"
 "OPTIONAL_CMD SHORT_UPLOAD\n"
 "OPTIONAL_CMD DOWNLOAD\n"
+#ifdef XCP_ENABLE_BLOCK_MODE
+"OPTIONAL_CMD DOWNLOAD_NEXT\n"
+#endif
 "OPTIONAL_CMD SHORT_DOWNLOAD\n"
 #ifdef XCP_ENABLE_CAL_PAGE
 "OPTIONAL_CMD GET_CAL_PAGE\n"
@@ -87,6 +113,9 @@ static const char* gA2lIfData1 = // Parameters %04X version, %u max cto, %u max
 #ifdef XCP_ENABLE_CHECKSUM
 "OPTIONAL_CMD BUILD_CHECKSUM\n"
 #endif
+#ifdef XCP_ENABLE_CAL_STORE
+"OPTIONAL_CMD SET_REQUEST\n"
+#endif
 //"OPTIONAL_CMD TRANSPORT_LAYER_CMD\n"
 //"OPTIONAL_CMD USER_CMD\n"
 "OPTIONAL_CMD GET_DAQ_RESOLUTION_INFO\n"
@@ -136,14 +165,15 @@ static const char* gA2lIfData1 = // Parameters %04X version, %u max cto, %u max
 
 //----------------------------------------------------------------------------------
 "/begin DAQ\n" // DAQ
-"DYNAMIC 0 %u 0 OPTIMISATION_TYPE_DEFAULT ADDRESS_EXTENSION_FREE IDENTIFICATION_FIELD_TYPE_RELATIVE_BYTE GRANULARITY_ODT_ENTRY_SIZE_DAQ_BYTE 0xF8 OVERLOAD_INDICATION_PID\n"
+"DYNAMIC 0 %u 0 OPTIMISATION_TYPE_DEFAULT ADDRESS_EXTENSION_FREE " A2L_IDENTIFICATION_FIELD_TYPE " GRANULARITY_ODT_ENTRY_SIZE_DAQ_BYTE 0xF8 OVERLOAD_INDICATION_PID\n"
+A2L_PRESCALER_SUPPORTED
 "/begin TIMESTAMP_SUPPORTED\n"
 "0x01 SIZE_DWORD %s TIMESTAMP_FIXED\n"
 "/end TIMESTAMP_SUPPORTED\n"; // ... Event list follows
 
-static const char* gA2lIfData2 = // Parameter %u port and %s ip address string
+static const char* gA2lIfData2 = // Parameter %s transport layer (UDP or TCP), %u port and %s ip address string
 "/end DAQ\n"
-"/begin XCP_ON_UDP_IP\n"
+"/begin XCP_ON_%s_IP\n"
 "  0x%04X %u ADDRESS \"%s\"\n"
 //"OPTIONAL_TL_SUBCMD GET_SLAVE_ID\n"
 //"OPTIONAL_TL_SUBCMD GET_DAQ_ID\n"
@@ -151,7 +181,7 @@ static const char* gA2lIfData2 = // Parameter %u port and %s ip address string
 #if defined(APP_ENABLE_MULTICAST) && defined(XCP_ENABLE_DAQ_CLOCK_MULTICAST)
 "  OPTIONAL_TL_SUBCMD GET_DAQ_CLOCK_MULTICAST\n"
 #endif
-"/end XCP_ON_UDP_IP\n" // Transport Layer
+"/end XCP_ON_%s_IP\n" // Transport Layer
 "/end IF_DATA\n\n"
 ;
 
@@ -264,7 +294,12 @@ void A2lHeader() {
   }
 #endif
 
-fprintf(gA2lFile, gA2lIfData2, XCP_TRANSPORT_LAYER_VERSION, getA2lSlavePort(), getA2lSlaveIP());
+#ifdef XCPTL_ENABLE_TCP
+const char* tl = gOptionUseTCP ? "TCP" : "UDP";
+#else
+const char* tl = "UDP";
+#endif
+fprintf(gA2lFile, gA2lIfData2, tl, XCP_TRANSPORT_LAYER_VERSION, getA2lSlavePort(), getA2lSlaveIP(), tl);
 }
 
 
@@ -320,6 +355,10 @@ void A2lCreateMeasurement_(const char* instanceName, const char* name, int size,
 	}
 	fprintf(gA2lFile, " /end MEASUREMENT\n");
 	gA2lMeasurements++;
+#ifdef XCP_ENABLE_MDF_RECORDER
+	// Measurements with fixed event are recorded by the MDF recorder
+	if (gA2lEvent >= 0) mdfCreateSignal(instanceName, name, size, addr, (uint16_t)gA2lEvent, factor, offset, unit, comment);
+#endif
 }
 
 
@@ -9,6 +9,8 @@ int gOptionJumbo = APP_DEFAULT_JUMBO;
 unsigned char gOptionSlaveAddr[4] = { 127,0,0,1 };
 uint16_t gOptionSlavePort = APP_DEFAULT_SLAVE_PORT;
 int gOptionUseXLAPI = FALSE;
+int gOptionUseIoUring = FALSE;
+int gOptionUseTCP = FALSE;
 
 #ifdef _WIN 
 #ifdef APP_ENABLE_XLAPI_V3
@@ -118,6 +118,15 @@ const struct ecuPar ecuRomPar = {
 static void ecuParInit() {
 
     memcpy((void*)&ecuPar,&ecuRomPar,sizeof(ecuPar));
+#ifdef XCP_ENABLE_CAL_STORE
+    // Restore the calibration of the last session
+    calStoreRegister((vuint8*)&ecuPar, (vuint32)sizeof(ecuPar));
+    calStoreOpen(XCP_CAL_STORE_FILE, ECU_PAR_VERSION);
+#endif
+#ifdef APP_ENABLE_CAL_SEGMENT
+    // ecuPar is the working page modified by XCP, ecuCyclic reads consistent copies
+    XcpCalSegInit((vuint8*)&ecuPar, (const vuint8*)&ecuRomPar, (vuint32)sizeof(ecuPar));
+#endif
 }
 
 // Init
@@ -279,10 +288,18 @@ void ecuCyclic( void )
     byteArray4[i] ++;
 
     // channel 1-6 demo signals
-    double x = M_2PI * ecuTime / ecuPar.period;
-    channel1 = ecuPar.offset1 + ecuPar.ampl1 * sin(x + ecuPar.phase1);
-    channel2 = ecuPar.offset2 + ecuPar.ampl2 * sin(x + ecuPar.phase2);
-    channel3 = ecuPar.offset3 + ecuPar.ampl3 * sin(x + ecuPar.phase3);
+#ifdef APP_ENABLE_CAL_SEGMENT
+    const struct ecuPar* par = (const struct ecuPar*)XcpCalSegLock(); // Consistent parameter set of the active calibration page
+#else
+    const volatile struct ecuPar* par = &ecuPar;
+#endif
+    double x = M_2PI * ecuTime / par->period;
+    channel1 = par->offset1 + par->ampl1 * sin(x + par->phase1);
+    channel2 = par->offset2 + par->ampl2 * sin(x + par->phase2);
+    channel3 = par->offset3 + par->ampl3 * sin(x + par->phase3);
+#ifdef APP_ENABLE_CAL_SEGMENT
+    XcpCalSegUnlock((const vuint8*)par);
+#endif
     ecuTime += 0.002;
 
     XcpEvent(gXcpEvent_EcuCyclic); // Trigger measurement data aquisition event for ecuCyclic() task
@@ -300,3 +317,78 @@ void* ecuTask(void* p) {
     }
     return 0;
 }
+
+
+#ifdef XCP_ENABLE_BENCHMARK
+
+// DAQ sampling benchmark with ODT shapes built from the byte and long arrays, in a single DAQ list and in 32 DAQ lists on 2 events
+// Returns 0 on error
+int ecuDaqBenchmark(unsigned int loops) {
+
+    unsigned char* b[16] = { byteArray1, byteArray2, byteArray3, byteArray4, byteArray5, byteArray6, byteArray7, byteArray8, byteArray9, byteArray10, byteArray11, byteArray12, byteArray13, byteArray14, byteArray15, byteArray16 };
+    uint32_t* l[16] = { longArray1, longArray2, longArray3, longArray4, longArray5, longArray6, longArray7, longArray8, longArray9, longArray10, longArray11, longArray12, longArray13, longArray14, longArray15, longArray16 };
+    static vuint32 addr[512];
+    static vuint8 size[512];
+    unsigned int i, j;
+    int ok = 1;
+
+    for (i = 0; i < 16; i++) { // Distinct values to verify the sampled data
+        for (j = 0; j < 1024; j++) { b[i][j] = (unsigned char)(i + j); l[i][j] = (i << 16) | j; }
+    }
+    printf("DAQ sampling benchmark, %u events per measurement\n", loops);
+
+    // Scattered 4 byte signals, gathered
+    for (i = 0; i < 512; i++) { addr[i] = ApplXcpGetAddr((vuint8*)&l[i % 16][(i * 37) % 1024]); size[i] = 4; }
+    ok &= XcpDaqBenchmark("longArray scattered", 512, addr, size, 1, loops);
+    ok &= XcpDaqBenchmark("longArray scattered", 512, addr, size, 32, loops); // 32 DAQ lists on 2 events
+
+    // Scattered 1 byte signals
+    for (i = 0; i < 512; i++) { addr[i] = ApplXcpGetAddr(&b[i % 16][(i * 37) % 1024]); size[i] = 1; }
+    ok &= XcpDaqBenchmark("byteArray scattered", 512, addr, size, 1, loops);
+    ok &= XcpDaqBenchmark("byteArray scattered", 512, addr, size, 32, loops);
+
+    // Consecutive 4 byte array elements, merged into a single copy per ODT
+    for (i = 0; i < 512; i++) { addr[i] = ApplXcpGetAddr((vuint8*)&longArray1[i]); size[i] = 4; }
+    ok &= XcpDaqBenchmark("longArray contiguous", 512, addr, size, 1, loops);
+
+    // Runs of 16 scattered 4 byte signals followed by 4 scattered 1 byte signals
+    for (i = 0; i < 512; i++) {
+        if (i % 20 < 16) { addr[i] = ApplXcpGetAddr((vuint8*)&l[i % 16][(i * 37) % 1024]); size[i] = 4; }
+        else { addr[i] = ApplXcpGetAddr(&b[i % 16][(i * 41) % 1024]); size[i] = 1; }
+    }
+    ok &= XcpDaqBenchmark("mixed", 512, addr, size, 1, loops);
+
+    return ok;
+}
+
+#endif
+
+
+#if defined(XCP_ENABLE_MDF_RECORDER) && defined(APP_ENABLE_A2L_GEN)
+
+// Record the measurements of event ecuCyclic to a MDF4 file for the given time, without XCP master
+// The signals are registered by the A2L generator, the A2L file is created as well
+// Returns 0 on error
+int ecuMdfRecord(const char* filename, unsigned int seconds) {
+
+    char* a2l;
+    uint64_t t;
+
+    ecuInit();
+    ApplXcpGetA2LFilename(&a2l, NULL, TRUE);
+    if (!A2lInit(a2l)) return 0;
+    A2lHeader();
+    ecuCreateA2lDescription();
+    A2lClose();
+
+    if (!mdfStart(filename)) return 0;
+    t = clockGet64();
+    while (clockGet64() - t < (uint64_t)seconds * CLOCK_TICKS_PER_S) {
+        sleepNs(ecuPar.cycleTime * 1000);
+        ecuCyclic();
+    }
+    mdfStop();
+    return 1;
+}
+
+#endif
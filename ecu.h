@@ -11,6 +11,8 @@ extern "C" {
 #endif
 
 
+#define ECU_PAR_VERSION 1 // Layout version of struct ecuPar in the calibration store, increment on changes
+
 struct ecuPar {
 
     unsigned int CALRAM_SIZE;
@@ -37,6 +39,14 @@ extern void ecuCreateA2lDescription();
 
 void* ecuTask(void* p);
 
+#ifdef XCP_ENABLE_BENCHMARK
+extern int ecuDaqBenchmark(unsigned int loops);
+#endif
+
+#if defined(XCP_ENABLE_MDF_RECORDER) && defined(APP_ENABLE_A2L_GEN)
+extern int ecuMdfRecord(const char* filename, unsigned int seconds);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -13,6 +13,7 @@
  ----------------------------------------------------------------------------*/
 
 #include "configuration.h"
+#include "ecu.h"
 
 
 // Commandline Options amd Defaults
@@ -22,6 +23,8 @@
 // unsigned char gOptionSlaveAddr[4] = { 127,0,0,1 };
 // uint16_t gOptionSlavePort = APP_DEFAULT_SLAVE_PORT;
 // int gOptionUseXLAPI = FALSE;
+// int gOptionUseIoUring = FALSE;
+// int gOptionUseTCP = FALSE;
 
 #ifdef _WIN 
 #ifdef APP_ENABLE_XLAPI_V3
@@ -104,6 +107,26 @@ static void usage() {
         "    -jumbo           Disable Jumbo Frames\n"
 #endif
         "    -a2l [path]      Generate A2L file\n"
+#ifdef XCPTL_ENABLE_TCP
+        "    -tcp             Use XCP on TCP (default is UDP)\n"
+#endif
+#ifdef XCPTL_ENABLE_IO_URING
+        "    -uring           Use io_uring transport backend\n"
+#endif
+#ifdef XCPTL_ENABLE_SHM
+        "    -shmread <event> <addr> <size> <s>\n"
+        "                     Run the shared memory reference reader against a running slave\n"
+#endif
+#if defined(XCP_ENABLE_MDF_RECORDER) && defined(APP_ENABLE_A2L_GEN)
+        "    -mdf <file> <s>  Record the ECU measurements to a MDF4 file for s seconds, without XCP master\n"
+#endif
+#ifdef XCP_ENABLE_BENCHMARK
+        "    -daqbench <n>    Measure the DAQ sampling time of n events for ODTs of the ECU arrays\n"
+#ifdef XCP_ENABLE_CHECKSUM
+        "    -csbench <kbyte> <n>\n"
+        "                     Measure the BUILD_CHECKSUM throughput of all checksum types\n"
+#endif
+#endif
 #ifdef APP_ENABLE_XLAPI_V3
         "    -v3              Use XL-API V3 (default is WINSOCK port 5555)\n"
         "    -net <netname>   V3 network (default: NET1)\n"
@@ -158,6 +181,63 @@ int main(int argc, char* argv[]) {
                 }
             }
         }
+#ifdef XCPTL_ENABLE_TCP
+        else if (strcmp(argv[i], "-tcp") == 0) {
+            gOptionUseTCP = TRUE;
+        }
+#endif
+#ifdef XCPTL_ENABLE_IO_URING
+        else if (strcmp(argv[i], "-uring") == 0) {
+            gOptionUseIoUring = TRUE;
+        }
+#endif
+#ifdef XCPTL_ENABLE_SHM
+        else if (strcmp(argv[i], "-shmread") == 0) {
+            unsigned int event, addr, size, seconds;
+            if (i + 4 < argc && sscanf(argv[i + 1], "%u", &event) == 1 && sscanf(argv[i + 2], "%x", &addr) == 1 && sscanf(argv[i + 3], "%u", &size) == 1 && sscanf(argv[i + 4], "%u", &seconds) == 1) {
+                clockInit();
+                exit(shmReaderBenchmark((uint16_t)event, addr, (uint8_t)size, seconds) ? 0 : 1);
+            }
+            usage();
+            exit(1);
+        }
+#endif
+#if defined(XCP_ENABLE_MDF_RECORDER) && defined(APP_ENABLE_A2L_GEN)
+        else if (strcmp(argv[i], "-mdf") == 0) {
+            unsigned int seconds;
+            if (i + 2 < argc && sscanf(argv[i + 2], "%u", &seconds) == 1 && seconds > 0) {
+                clockInit();
+                XcpInit();
+                exit(ecuMdfRecord(argv[i + 1], seconds) ? 0 : 1);
+            }
+            usage();
+            exit(1);
+        }
+#endif
+#ifdef XCP_ENABLE_BENCHMARK
+        else if (strcmp(argv[i], "-daqbench") == 0) {
+            unsigned int loops;
+            if (i + 1 < argc && sscanf(argv[i + 1], "%u", &loops) == 1 && loops > 0) {
+                clockInit();
+                XcpInit();
+                exit(ecuDaqBenchmark(loops) ? 0 : 1);
+            }
+            usage();
+            exit(1);
+        }
+#ifdef XCP_ENABLE_CHECKSUM
+        else if (strcmp(argv[i], "-csbench") == 0) {
+            unsigned int kbytes, loops;
+            if (i + 2 < argc && sscanf(argv[i + 1], "%u", &kbytes) == 1 && sscanf(argv[i + 2], "%u", &loops) == 1 && loops > 0) {
+                clockInit();
+                XcpInit();
+                exit(XcpChecksumBenchmark(kbytes * 1024, loops) ? 0 : 1);
+            }
+            usage();
+            exit(1);
+        }
+#endif
+#endif
 #ifdef APP_ENABLE_XLAPI_V3
         else if (strcmp(argv[i], "-v3") == 0) {
             uint8_t a[4] = APP_DEFAULT_SLAVE_IP;
@@ -175,6 +255,9 @@ int main(int argc, char* argv[]) {
     }
     if (gDebugLevel) printf("Set screen output verbosity to %u\n", gDebugLevel);
     if (gOptionJumbo) printf("Using Jumbo Frames\n");
+#ifdef XCPTL_ENABLE_TCP
+    if (gOptionUseTCP) printf("Using XCP on TCP\n");
+#endif
 #ifdef APP_ENABLE_XLAPI_V3
     if (gOptionUseXLAPI) {
         printf("Using XL-API V3\n");
@@ -25,6 +25,9 @@
 #ifndef _WIN // Linux
 
 #define _DEFAULT_SOURCE
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // sendmmsg
+#endif
 
 #include <stdio.h>
 #include <stdarg.h>
@@ -44,10 +47,15 @@
 
 #include <ifaddrs.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <poll.h>
 
 #define MAX_PATH 256
 
@@ -165,6 +173,9 @@
 #endif
 
 #include "xcpTl.h" // XCP on UDP transport layer
+#include "shmTl.h" // XCP on shared memory transport layer
+#include "xcpRec.h" // DAQ pre-trigger recorder
+#include "xcpMdf.h" // DAQ recorder to MDF4 file
 #include "xcpSlave.h" // XCP slave
 
 #ifdef APP_ENABLE_A2L_GEN // Enable A2L generator
@@ -188,6 +199,8 @@ extern uint16_t gOptionSlavePort;
 extern unsigned char gOptionSlaveAddr[4];
 extern char gOptionA2L_Path[MAX_PATH];
 extern int gOptionUseXLAPI;
+extern int gOptionUseIoUring;
+extern int gOptionUseTCP;
 
 #ifdef APP_ENABLE_XLAPI_V3
     extern char gOptionXlSlaveNet[32];
@@ -0,0 +1,396 @@
+/*----------------------------------------------------------------------------
+| File:
+|   shmTl.c
+|
+| Description:
+|   XCP on shared memory transport layer for masters on the same host
+|   Linux version
+|   Memory mapped ring of XCP packets and a command mailbox
+|   Contains a reference reader for throughput measurements
+|
+| Copyright (c) Vector Informatik GmbH. All rights reserved.
+| Licensed under the MIT license. See LICENSE file in the project root for details.
+|
+ ----------------------------------------------------------------------------*/
+
+#include "configuration.h"
+
+#ifdef XCPTL_ENABLE_SHM
+
+#include <sys/mman.h>
+
+
+// Shared memory, mapped by the slave or by the reader
+static tShmTlData* gShm = NULL;
+static int gShmFd = -1;
+
+// Slot index of a position
+#define SLOT(pos) (&gShm->slots[(pos) % XCPTL_SHM_SLOT_COUNT])
+
+// Map the shared memory object
+static int shmMap(int create) {
+
+    gShmFd = shm_open(XCPTL_SHM_NAME, create ? (O_CREAT | O_RDWR | O_TRUNC) : O_RDWR, 0666);
+    if (gShmFd < 0) {
+        printf("ERROR: cannot open shared memory %s (errno=%d)!\n", XCPTL_SHM_NAME, errno);
+        return 0;
+    }
+    if (create && ftruncate(gShmFd, sizeof(tShmTlData)) < 0) {
+        printf("ERROR: cannot resize shared memory (errno=%d)!\n", errno);
+        close(gShmFd);
+        return 0;
+    }
+    gShm = (tShmTlData*)mmap(NULL, sizeof(tShmTlData), PROT_READ | PROT_WRITE, MAP_SHARED, gShmFd, 0);
+    if (gShm == MAP_FAILED) {
+        printf("ERROR: cannot map shared memory (errno=%d)!\n", errno);
+        gShm = NULL;
+        close(gShmFd);
+        return 0;
+    }
+    return 1;
+}
+
+static void shmUnmap() {
+
+    if (gShm != NULL) munmap(gShm, sizeof(tShmTlData));
+    gShm = NULL;
+    if (gShmFd >= 0) close(gShmFd);
+    gShmFd = -1;
+}
+
+
+//------------------------------------------------------------------------------
+// Slave
+
+int shmTlInit() {
+
+    printf("\nInit XCP on SHM transport layer\n  (SHM=%s, SLOTS=%u, SIZE=%u)\n", XCPTL_SHM_NAME, XCPTL_SHM_SLOT_COUNT, (uint32_t)sizeof(tShmTlData));
+
+    if (!shmMap(TRUE)) return 0;
+    memset(gShm, 0, sizeof(tShmTlData));
+    gShm->slot_count = XCPTL_SHM_SLOT_COUNT;
+    gShm->slot_size = sizeof(tShmTlSlot);
+    if (sem_init(&gShm->cmd_sem, 1, 0) != 0 || sem_init(&gShm->rx_sem, 1, 0) != 0) {
+        printf("ERROR: sem_init failed (errno=%d)!\n", errno);
+        return 0;
+    }
+    atomicStore32(&gShm->magic, SHMTL_MAGIC); // Ready for readers
+    printf("  Listening on shared memory %s\n", XCPTL_SHM_NAME);
+    return 1;
+}
+
+void shmTlShutdown() {
+
+    if (gShm == NULL) return;
+    gShm->magic = 0;
+    sem_destroy(&gShm->cmd_sem);
+    sem_destroy(&gShm->rx_sem);
+    shmUnmap();
+    shm_unlink(XCPTL_SHM_NAME);
+}
+
+// Handle an incoming XCP command from the mailbox
+// Blocking with timeout, returns 0 on error
+int shmTlHandleCommands() {
+
+    struct timespec ts;
+    int connected;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += 100000000; // 100ms
+    if (ts.tv_nsec >= 1000000000) { ts.tv_sec++; ts.tv_nsec -= 1000000000; }
+    if (sem_timedwait(&gShm->cmd_sem, &ts) != 0) {
+        if (errno == ETIMEDOUT || errno == EINTR) return 1; // Ok, no command
+        printf("ERROR: sem_timedwait failed (errno=%d)!\n", errno);
+        return 0; // Error
+    }
+    if (!atomicLoad32(&gShm->cmd_state)) return 1; // Spurious
+
+    if (gShm->cmd.dlc >= 1 && gShm->cmd.dlc <= XCPTL_CTO_SIZE) {
+
+        connected = XcpIsConnected();
+
+#ifdef XCP_ENABLE_TESTMODE
+        if (gDebugLevel >= 4 || (!connected && gDebugLevel >= 1)) {
+            printf("RX: CTR %04X LEN %04X DATA = ", gShm->cmd.ctr, gShm->cmd.dlc);
+            for (int i = 0; i < gShm->cmd.dlc; i++) printf("%0X ", gShm->cmd.data[i]);
+            printf("\n");
+        }
+#endif
+
+        // Any command is accepted when connected, only CONNECT when not connected
+        const tXcpCto* pCmd = (const tXcpCto*)&gShm->cmd.data[0];
+        if (connected || (gShm->cmd.dlc == 2 && CRO_CMD == CC_CONNECT)) {
+            XcpCommand((const vuint32*)&gShm->cmd.data[0]);
+        }
+#ifdef XCP_ENABLE_TESTMODE
+        else if (gDebugLevel >= 1) {
+            printf("WARNING: no valid CONNECT command\n");
+        }
+#endif
+        if (!connected && XcpIsConnected()) printf("XCP master connected on shared memory\n");
+    }
+    else {
+        printf("WARNING: invalid command length %u received!\n", gShm->cmd.dlc);
+    }
+
+    atomicStore32(&gShm->cmd_state, 0); // Mailbox empty
+    return 1;
+}
+
+// Reserve a slot for a packet and return a pointer to data and a pointer to the slot for commit reference
+// Thread safe and lock free
+unsigned char* shmTlGetPacketBuffer(void** par, unsigned int size) {
+
+    tShmTlSlot* s;
+    uint64_t wp;
+
+    if (size > XCPTL_DTO_SIZE) return NULL; // Does not fit into a slot
+
+    do {
+        wp = atomicLoad64(&gShm->wp);
+        if (wp - atomicLoad64(&gShm->rp) >= XCPTL_SHM_SLOT_COUNT) return NULL; // Overflow
+    } while (!atomicCas64(&gShm->wp, wp, wp + 1));
+
+    // Build XCP message header (ctr+dlc), the packet counter is the low word of the ring position
+    s = SLOT(wp);
+    s->msg.ctr = (uint16_t)wp;
+    s->msg.dlc = (uint16_t)size;
+
+    *((tShmTlSlot**)par) = s;
+    return &s->msg.data[0];
+}
+
+// Commit a packet reserved by shmTlGetPacketBuffer
+// Thread safe and lock free
+void shmTlCommitPacketBuffer(void* par) {
+
+    tShmTlSlot* s = (tShmTlSlot*)par;
+
+    if (s != NULL) {
+        atomicStore32(&s->state, 1);
+        // Wake up the reader, if it is waiting in shmReaderPeek
+        if (atomicLoad32(&gShm->rx_waiting)) {
+            atomicStore32(&gShm->rx_waiting, 0);
+            sem_post(&gShm->rx_sem);
+        }
+    }
+}
+
+// Reserve count consecutive slots with a single operation and return pointers to their data
+// Returns 0 on overflow
+// Thread safe and lock free
+int shmTlGetPacketBuffers(void** par, unsigned int count, const uint16_t* sizes, unsigned char** data) {
+
+    tShmTlSlot* s;
+    uint64_t wp;
+    unsigned int i;
+
+    for (i = 0; i < count; i++) if (sizes[i] > XCPTL_DTO_SIZE) return 0; // Does not fit into a slot
+
+    do {
+        wp = atomicLoad64(&gShm->wp);
+        if (wp + count - atomicLoad64(&gShm->rp) > XCPTL_SHM_SLOT_COUNT) return 0; // Overflow
+    } while (!atomicCas64(&gShm->wp, wp, wp + count));
+
+    for (i = 0; i < count; i++) {
+        s = SLOT(wp + i);
+        s->msg.ctr = (uint16_t)(wp + i);
+        s->msg.dlc = sizes[i];
+        data[i] = &s->msg.data[0];
+    }
+    *((tShmTlSlot**)par) = SLOT(wp); // Handle is the first slot
+    return 1;
+}
+
+// Commit count packets reserved by shmTlGetPacketBuffers
+// Thread safe and lock free
+void shmTlCommitPacketBuffers(void* par, unsigned int count, unsigned int size) {
+
+    unsigned int first = (unsigned int)((tShmTlSlot*)par - &gShm->slots[0]);
+    unsigned int i;
+    (void)size;
+
+    for (i = 0; i < count; i++) atomicStore32(&SLOT(first + i)->state, 1);
+    // Wake up the reader, if it is waiting in shmReaderPeek
+    if (atomicLoad32(&gShm->rx_waiting)) {
+        atomicStore32(&gShm->rx_waiting, 0);
+        sem_post(&gShm->rx_sem);
+    }
+}
+
+// Start or stop DAQ
+// Packets in the ring are owned by the reader, nothing to reset
+void shmTlInitTransmitQueue() {
+}
+
+// Transmit XCP response or event packet in the packet ring
+// Returns 0 error, 1 ok
+int shmTlSendCrmPacket(const unsigned char* packet, unsigned int size) {
+
+    void* p;
+    unsigned char* d;
+    unsigned int retries = SEND_RETRIES;
+    assert(packet != NULL);
+    assert(size > 0);
+
+    while ((d = shmTlGetPacketBuffer(&p, size)) == NULL) { // Retry while the ring is full
+        if (--retries == 0) return 0;
+        sleepMs(1);
+    }
+    memcpy(d, packet, size);
+    shmTlCommitPacketBuffer(p);
+    return 1;
+}
+
+
+//------------------------------------------------------------------------------
+// Reference reader
+
+static uint16_t gShmReaderCtr = 0; // Command packet counter
+
+int shmReaderOpen() {
+
+    if (!shmMap(FALSE)) return 0;
+    if (atomicLoad32(&gShm->magic) != SHMTL_MAGIC || gShm->slot_count != XCPTL_SHM_SLOT_COUNT || gShm->slot_size != sizeof(tShmTlSlot)) {
+        printf("ERROR: shared memory %s not initialized or incompatible!\n", XCPTL_SHM_NAME);
+        shmUnmap();
+        return 0;
+    }
+    return 1;
+}
+
+void shmReaderClose() {
+
+    shmUnmap();
+}
+
+// Get the next commited packet, wait at most timeout_us
+// Returns NULL on timeout, the packet must be released with shmReaderRelease
+const tXcpDtoMessage* shmReaderPeek(unsigned int timeout_us) {
+
+    tShmTlSlot* s = SLOT(gShm->rp);
+    struct timespec ts;
+
+    if (atomicLoad32(&s->state)) return &s->msg;
+    if (timeout_us == 0) return NULL;
+
+    // Announce waiting and check again, to avoid a lost wakeup
+    atomicStore32(&gShm->rx_waiting, 1);
+    if (!atomicLoad32(&s->state)) {
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += timeout_us / 1000000;
+        ts.tv_nsec += (long)(timeout_us % 1000000) * 1000;
+        if (ts.tv_nsec >= 1000000000) { ts.tv_sec++; ts.tv_nsec -= 1000000000; }
+        sem_timedwait(&gShm->rx_sem, &ts);
+    }
+    atomicStore32(&gShm->rx_waiting, 0);
+    return atomicLoad32(&s->state) ? &s->msg : NULL;
+}
+
+// Free the packet returned by shmReaderPeek
+void shmReaderRelease() {
+
+    tShmTlSlot* s = SLOT(gShm->rp);
+    s->state = 0;
+    atomicStore64(&gShm->rp, gShm->rp + 1);
+}
+
+// Send a XCP command and wait for the response
+// DTO packets received before the response are discarded
+// Returns 1 and the response in res on positive response, 0 on error or timeout
+int shmReaderCommand(const unsigned char* cmd, unsigned int n, tXcpCtoMessage* res) {
+
+    const tXcpDtoMessage* p;
+    unsigned int timeout = 100; // ms
+
+    assert(n >= 1 && n <= XCPTL_CTO_SIZE);
+    while (atomicLoad32(&gShm->cmd_state)) { // Previous command still pending
+        if (--timeout == 0) return 0;
+        sleepMs(1);
+    }
+    gShm->cmd.ctr = gShmReaderCtr++;
+    gShm->cmd.dlc = (uint16_t)n;
+    memcpy(gShm->cmd.data, cmd, n);
+    atomicStore32(&gShm->cmd_state, 1);
+    sem_post(&gShm->cmd_sem);
+
+    for (timeout = 1000; timeout > 0; timeout--) {
+        if ((p = shmReaderPeek(1000)) == NULL) continue;
+        if (p->data[0] >= PID_ERR) { // Response or error
+            if (res != NULL) memcpy(res, p, XCPTL_TRANSPORT_LAYER_HEADER_SIZE + p->dlc);
+            timeout = (p->data[0] == PID_RES);
+            shmReaderRelease();
+            return timeout;
+        }
+        shmReaderRelease(); // DTO, event or service packet
+    }
+    return 0;
+}
+
+// Measure throughput of a single ODT DAQ list with one entry, triggered by an existing event
+// The slave must be running in another process
+int shmReaderBenchmark(uint16_t event, uint32_t addr, uint8_t size, unsigned int seconds) {
+
+    const tXcpDtoMessage* p;
+    uint64_t packets = 0, bytes = 0, gaps = 0;
+    uint64_t t0;
+    uint16_t ctr = 0;
+    int first = 1;
+    int ok;
+
+    if (!shmReaderOpen()) return 0;
+
+    // Connect and setup a DAQ list
+    unsigned char cConnect[] = { CC_CONNECT, 0 };
+    unsigned char cFree[] = { CC_FREE_DAQ };
+    unsigned char cAllocDaq[] = { CC_ALLOC_DAQ, 0, 1, 0 };
+    unsigned char cAllocOdt[] = { CC_ALLOC_ODT, 0, 0, 0, 1 };
+    unsigned char cAllocEntry[] = { CC_ALLOC_ODT_ENTRY, 0, 0, 0, 0, 1 };
+    unsigned char cSetPtr[] = { CC_SET_DAQ_PTR, 0, 0, 0, 0, 0 };
+    unsigned char cWrite[] = { CC_WRITE_DAQ, 0xFF, size, 0, (uint8_t)addr, (uint8_t)(addr >> 8), (uint8_t)(addr >> 16), (uint8_t)(addr >> 24) };
+    unsigned char cMode[] = { CC_SET_DAQ_LIST_MODE, DAQ_FLAG_TIMESTAMP, 0, 0, (uint8_t)event, (uint8_t)(event >> 8), 1, 0 };
+    unsigned char cSelect[] = { CC_START_STOP_DAQ_LIST, 2, 0, 0 };
+    unsigned char cStart[] = { CC_START_STOP_SYNCH, 1 };
+    unsigned char cStop[] = { CC_START_STOP_SYNCH, 0 };
+    unsigned char cDisconnect[] = { CC_DISCONNECT };
+    ok = shmReaderCommand(cConnect, sizeof(cConnect), NULL) &&
+        shmReaderCommand(cFree, sizeof(cFree), NULL) &&
+        shmReaderCommand(cAllocDaq, sizeof(cAllocDaq), NULL) &&
+        shmReaderCommand(cAllocOdt, sizeof(cAllocOdt), NULL) &&
+        shmReaderCommand(cAllocEntry, sizeof(cAllocEntry), NULL) &&
+        shmReaderCommand(cSetPtr, sizeof(cSetPtr), NULL) &&
+        shmReaderCommand(cWrite, sizeof(cWrite), NULL) &&
+        shmReaderCommand(cMode, sizeof(cMode), NULL) &&
+        shmReaderCommand(cSelect, sizeof(cSelect), NULL) &&
+        shmReaderCommand(cStart, sizeof(cStart), NULL);
+    if (!ok) {
+        printf("ERROR: DAQ setup failed!\n");
+        shmReaderClose();
+        return 0;
+    }
+
+    // Receive DTO packets
+    printf("Measuring event %u, addr=%08Xh, size=%u for %us\n", event, addr, size, seconds);
+    t0 = clockGet64();
+    for (;;) {
+        if (clockGet64() - t0 >= (uint64_t)seconds * CLOCK_TICKS_PER_S) break;
+        if ((p = shmReaderPeek(100000)) == NULL) continue;
+        if (!first && p->ctr != ctr) gaps++;
+        first = 0;
+        ctr = p->ctr + 1;
+        packets++;
+        bytes += XCPTL_TRANSPORT_LAYER_HEADER_SIZE + p->dlc;
+        shmReaderRelease();
+    }
+
+    shmReaderCommand(cStop, sizeof(cStop), NULL);
+    shmReaderCommand(cDisconnect, sizeof(cDisconnect), NULL);
+    shmReaderClose();
+
+    printf("Received %llu packets, %llu bytes, %llu counter gaps\n", (unsigned long long)packets, (unsigned long long)bytes, (unsigned long long)gaps);
+    printf("  %.0f packets/s, %.3f MByte/s\n", (double)packets / seconds, (double)bytes / seconds / 1000000.0);
+    return 1;
+}
+
+#endif
@@ -0,0 +1,80 @@
+/* shmTl.h */
+
+/* Copyright(c) Vector Informatik GmbH.All rights reserved.
+   Licensed under the MIT license.See LICENSE file in the project root for details. */
+
+#ifndef __SHMTL_H__
+#define __SHMTL_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef _LINUX // Linux only transport layer
+    #undef XCPTL_ENABLE_SHM
+#endif
+
+#ifdef XCPTL_ENABLE_SHM
+
+#include <semaphore.h>
+
+#define SHMTL_MAGIC 0x4D485358 // "XSHM"
+
+// Packet slot in the shared memory ring
+typedef struct {
+    volatile uint32_t state; // 0 = free, 1 = commited, written by the producer, reset by the reader
+    uint32_t res;
+    tXcpDtoMessage msg; // XCP message (dlc+ctr+data)
+} tShmTlSlot;
+
+// Shared memory layout
+typedef struct {
+
+    uint32_t magic; // SHMTL_MAGIC, valid when the slave is initialized
+    uint32_t slot_count;
+    uint32_t slot_size;
+    uint32_t res;
+
+    // Command mailbox, written by the reader, a single command is pending at a time
+    sem_t cmd_sem; // Posted by the reader, when a command is pending
+    volatile uint32_t cmd_state; // 0 = empty, 1 = command pending
+    tXcpCtoMessage cmd;
+
+    // Reader wakeup
+    sem_t rx_sem; // Posted by the producers, when a packet is commited and the reader is waiting
+    volatile uint32_t rx_waiting; // Reader is waiting for rx_sem
+
+    // Packet ring
+    // Lock free, multiple producers in the slave process (XCP event threads and CMD thread) and a single reader
+    volatile uint64_t wp __attribute__((aligned(64))); // Write position, number of reserved slots, written by the producers
+    volatile uint64_t rp __attribute__((aligned(64))); // Read position, number of read slots, written by the reader only
+    tShmTlSlot slots[XCPTL_SHM_SLOT_COUNT] __attribute__((aligned(64)));
+
+} tShmTlData;
+
+// Slave
+extern int shmTlInit();
+extern void shmTlShutdown();
+extern int shmTlHandleCommands();
+extern unsigned char* shmTlGetPacketBuffer(void** par, unsigned int size);
+extern void shmTlCommitPacketBuffer(void* par);
+extern int shmTlGetPacketBuffers(void** par, unsigned int count, const uint16_t* sizes, unsigned char** data);
+extern void shmTlCommitPacketBuffers(void* par, unsigned int count, unsigned int size);
+extern void shmTlInitTransmitQueue();
+extern int shmTlSendCrmPacket(const unsigned char* data, unsigned int n);
+
+// Reference reader
+extern int shmReaderOpen();
+extern void shmReaderClose();
+extern int shmReaderCommand(const unsigned char* cmd, unsigned int n, tXcpCtoMessage* res);
+extern const tXcpDtoMessage* shmReaderPeek(unsigned int timeout_us);
+extern void shmReaderRelease();
+extern int shmReaderBenchmark(uint16_t event, uint32_t addr, uint8_t size, unsigned int seconds);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
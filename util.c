@@ -53,7 +53,7 @@ int _kbhit() {
 
 
 /**************************************************************************/
-// Mutex
+// Mutex and condition variable
 /**************************************************************************/
 
 #ifdef _LINUX
@@ -76,6 +76,34 @@ void mutexDestroy(MUTEX* m) {
     pthread_mutex_destroy(m);
 }
 
+void condInit(COND* c) {
+
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_cond_init(c, &ca);
+    pthread_condattr_destroy(&ca);
+}
+
+void condDestroy(COND* c) {
+
+    pthread_cond_destroy(c);
+}
+
+// Wait for a signal or timeout after timeout_ms, the mutex m must be locked
+void condWait(COND* c, MUTEX* m, uint32_t timeout_ms) {
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    t.tv_sec += timeout_ms / 1000;
+    t.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (t.tv_nsec >= 1000000000) {
+        t.tv_sec++;
+        t.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(c, m, &t);
+}
+
 #else 
 
 void mutexInit(MUTEX* m, int recursive, uint32_t spinCount) {
@@ -88,6 +116,23 @@ void mutexDestroy(MUTEX* m) {
     DeleteCriticalSection(m);
 }
 
+void condInit(COND* c) {
+
+    InitializeConditionVariable(c);
+}
+
+void condDestroy(COND* c) {
+
+    // Windows condition variables need no cleanup
+    (void)c;
+}
+
+// Wait for a signal or timeout after timeout_ms, the mutex m must be locked
+void condWait(COND* c, MUTEX* m, uint32_t timeout_ms) {
+
+    SleepConditionVariableCS(c, m, timeout_ms);
+}
+
 #endif
 
 
@@ -97,10 +142,10 @@ void mutexDestroy(MUTEX* m) {
 
 #ifdef _LINUX
 
-int socketOpen(SOCKET* sp, int nonBlocking, int reuseaddr) {
+int socketOpen(SOCKET* sp, int useTCP, int nonBlocking, int reuseaddr) {
 
     // Create a socket
-    *sp = socket(AF_INET, SOCK_DGRAM, 0);
+    *sp = socket(AF_INET, useTCP ? SOCK_STREAM : SOCK_DGRAM, 0);
     if (*sp < 0) {
         printf("ERROR: cannot open socket!\n");
         return 0;
@@ -122,7 +167,7 @@ int socketBind(SOCKET sock, uint16_t port) {
     a.sin_addr.s_addr = htonl(INADDR_ANY);
     a.sin_port = htons(port);
     if (bind(sock, (SOCKADDR*)&a, sizeof(a)) < 0) {
-        printf("ERROR %u: cannot bind on UDP port %u!\n", socketGetLastError(), port);
+        printf("ERROR %u: cannot bind on port %u!\n", socketGetLastError(), port);
         return 0;
     }
 
@@ -130,9 +175,25 @@ int socketBind(SOCKET sock, uint16_t port) {
 }
 
 
+int socketListen(SOCKET sock) {
+
+    if (listen(sock, 5) < 0) {
+        printf("ERROR %u: listen failed!\n", socketGetLastError());
+        return 0;
+    }
+    return 1;
+}
+
+SOCKET socketAccept(SOCKET sock, SOCKADDR_IN* addr) {
+
+    socklen_t addrlen = sizeof(*addr);
+    return accept(sock, (SOCKADDR*)addr, &addrlen);
+}
+
 int socketClose(SOCKET *sp) {
     if (*sp != INVALID_SOCKET) {
         shutdown(*sp, SHUT_RDWR);
+        close(*sp);
         *sp = INVALID_SOCKET;
     }
     return 1;
@@ -143,20 +204,22 @@ int socketClose(SOCKET *sp) {
 
 #ifdef _WIN
 
-int socketOpen(SOCKET* sp, int nonBlocking, int reuseaddr) {
+int socketOpen(SOCKET* sp, int useTCP, int nonBlocking, int reuseaddr) {
     
     // Create a socket
-    *sp = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    *sp = socket(AF_INET, useTCP ? SOCK_STREAM : SOCK_DGRAM, useTCP ? IPPROTO_TCP : IPPROTO_UDP);
     if (*sp == INVALID_SOCKET) {
         printf("ERROR %u: could not create socket!\n", socketGetLastError());
         return 0;
     }
     
     // Avoid send to UDP nowhere problem (server has no open socket on master port) (stack-overlow 34242622)
-    #define SIO_UDP_CONNRESET _WSAIOW(IOC_VENDOR, 12)
-    BOOL bNewBehavior = FALSE;
-    DWORD dwBytesReturned = 0;
-    WSAIoctl(*sp, SIO_UDP_CONNRESET, &bNewBehavior, sizeof bNewBehavior, NULL, 0, &dwBytesReturned, NULL, NULL);
+    if (!useTCP) {
+        #define SIO_UDP_CONNRESET _WSAIOW(IOC_VENDOR, 12)
+        BOOL bNewBehavior = FALSE;
+        DWORD dwBytesReturned = 0;
+        WSAIoctl(*sp, SIO_UDP_CONNRESET, &bNewBehavior, sizeof bNewBehavior, NULL, 0, &dwBytesReturned, NULL, NULL);
+    }
 
     // Set nonblocking mode 
     uint32_t b = nonBlocking ? 1:0;
@@ -187,13 +250,28 @@ int socketBind(SOCKET sock, uint16_t port) {
             printf("ERROR: Port is already in use!\n");
         }
         else {
-            printf("ERROR %u: cannot bind on UDP port %u!\n", socketGetLastError(), port);
+            printf("ERROR %u: cannot bind on port %u!\n", socketGetLastError(), port);
         }
         return 0;
     }
     return 1;
 }
 
+int socketListen(SOCKET sock) {
+
+    if (listen(sock, 5) == SOCKET_ERROR) {
+        printf("ERROR %u: listen failed!\n", socketGetLastError());
+        return 0;
+    }
+    return 1;
+}
+
+SOCKET socketAccept(SOCKET sock, SOCKADDR_IN* addr) {
+
+    int addrlen = sizeof(*addr);
+    return accept(sock, (SOCKADDR*)addr, &addrlen);
+}
+
 int socketClose(SOCKET *sock) {
 
     if (*sock != INVALID_SOCKET) {
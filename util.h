@@ -36,6 +36,55 @@ void mutexInit(MUTEX* m, int recursive, uint32_t spinCount);
 void mutexDestroy(MUTEX* m);
 
 
+//-------------------------------------------------------------------------------
+// Condition variable, used together with a MUTEX
+
+#ifdef _LINUX
+
+#define COND pthread_cond_t
+#define condSignalAll pthread_cond_broadcast
+
+#else
+
+#define COND CONDITION_VARIABLE
+#define condSignalAll WakeAllConditionVariable
+
+#endif
+
+void condInit(COND* c);
+void condDestroy(COND* c);
+void condWait(COND* c, MUTEX* m, uint32_t timeout_ms);
+
+
+//-------------------------------------------------------------------------------
+// Atomics
+// Sequentially consistent operations on naturally aligned 32 and 64 bit integers
+
+#ifdef _LINUX
+
+#define atomicLoad32(p) __atomic_load_n(p,__ATOMIC_SEQ_CST)
+#define atomicStore32(p,v) __atomic_store_n(p,v,__ATOMIC_SEQ_CST)
+#define atomicAdd32(p,v) __atomic_add_fetch(p,v,__ATOMIC_SEQ_CST) // Returns the new value
+#define atomicExchange32(p,v) __atomic_exchange_n(p,v,__ATOMIC_SEQ_CST) // Returns the old value
+#define atomicCas32(p,o,n) __sync_bool_compare_and_swap(p,o,n) // Returns TRUE, if *p was o and has been replaced by n
+#define atomicLoad64(p) __atomic_load_n(p,__ATOMIC_SEQ_CST)
+#define atomicStore64(p,v) __atomic_store_n(p,v,__ATOMIC_SEQ_CST)
+#define atomicCas64(p,o,n) __sync_bool_compare_and_swap(p,o,n) // Returns TRUE, if *p was o and has been replaced by n
+
+#else
+
+#define atomicLoad32(p) ((uint32_t)InterlockedCompareExchange((volatile LONG*)(p),0,0))
+#define atomicStore32(p,v) InterlockedExchange((volatile LONG*)(p),(LONG)(v))
+#define atomicAdd32(p,v) ((uint32_t)InterlockedAdd((volatile LONG*)(p),(LONG)(v))) // Returns the new value
+#define atomicExchange32(p,v) ((uint32_t)InterlockedExchange((volatile LONG*)(p),(LONG)(v))) // Returns the old value
+#define atomicCas32(p,o,n) (InterlockedCompareExchange((volatile LONG*)(p),(LONG)(n),(LONG)(o))==(LONG)(o)) // Returns TRUE, if *p was o and has been replaced by n
+#define atomicLoad64(p) ((uint64_t)InterlockedCompareExchange64((volatile LONG64*)(p),0,0))
+#define atomicStore64(p,v) InterlockedExchange64((volatile LONG64*)(p),(LONG64)(v))
+#define atomicCas64(p,o,n) (InterlockedCompareExchange64((volatile LONG64*)(p),(LONG64)(n),(LONG64)(o))==(LONG64)(o)) // Returns TRUE, if *p was o and has been replaced by n
+
+#endif
+
+
 //-------------------------------------------------------------------------------
 // Threads
 
@@ -76,8 +125,10 @@ void mutexDestroy(MUTEX* m);
 
 #endif
 
-extern int socketOpen(SOCKET* sp, int nonBlocking, int reuseaddr);
+extern int socketOpen(SOCKET* sp, int useTCP, int nonBlocking, int reuseaddr);
 extern int socketBind(SOCKET sock, uint16_t port);
+extern int socketListen(SOCKET sock);
+extern SOCKET socketAccept(SOCKET sock, SOCKADDR_IN* addr);
 extern int socketJoin(SOCKET sock, uint8_t* multicastAddr);
 extern int socketRecv(SOCKET sock, uint8_t* buffer, uint16_t bufferSize);
 extern int socketRecvFrom(SOCKET sock, uint8_t* buffer, uint16_t bufferSize, uint8_t *addr, uint16_t *port);
@@ -14,6 +14,10 @@
 
 #include "configuration.h"
 
+#ifdef XCP_ENABLE_CAL_PAGE
+static vuint8* calSegGetPointer(vuint8* p);
+#endif
+
 #ifdef XCP_ENABLE_GRANDMASTER_CLOCK_INFO
 
 
@@ -69,7 +73,11 @@ vuint8 baseAddrValid = FALSE;
 
 vuint8* ApplXcpGetPointer(vuint8 addr_ext, vuint32 addr) {
 
+#ifdef XCP_ENABLE_CAL_PAGE
+    return calSegGetPointer(ApplXcpGetBaseAddr() + addr);
+#else
     return ApplXcpGetBaseAddr() + addr;
+#endif
 }
 
 vuint32 ApplXcpGetAddr(vuint8* p) {
@@ -99,7 +107,9 @@ vuint8* ApplXcpGetBaseAddr() {
 
 #ifdef _LINUX64
 
+#ifndef __USE_GNU
 #define __USE_GNU
+#endif
 #include <link.h>
 
 vuint8* baseAddr = NULL;
@@ -140,7 +150,11 @@ vuint32 ApplXcpGetAddr(vuint8* p)
 vuint8* ApplXcpGetPointer(vuint8 addr_ext, vuint32 addr)
 {
   ApplXcpGetBaseAddr();
+#ifdef XCP_ENABLE_CAL_PAGE
+  return calSegGetPointer(baseAddr + addr);
+#else
   return baseAddr + addr;
+#endif
 }
 
 
@@ -156,16 +170,210 @@ vuint8* ApplXcpGetPointer(vuint8 addr_ext, vuint32 addr)
 
 #ifdef XCP_ENABLE_CAL_PAGE
 
-vuint8 calPage = 0; // RAM = 0, FLASH = 1
+// Calibration segment with a working page (RAM = 0) and a reference page (FLASH = 1)
+// XCP writes to the working page at the segment address, the ECU reads a consistent copy, which is published after each download or transaction
+// The two copies are published alternately, a copy is overwritten only after its last reader has left
+// Only the address ranges modified since the copy was published last are copied
+
+#define CAL_SEG_REF 2 // Index of the reference page
+
+// Delta log, address ranges of the working page modified by XCP
+typedef struct {
+    vuint32 count;
+    vuint8 overflow; // Too many ranges, the whole page has to be copied
+    struct {
+        vuint32 offset;
+        vuint32 size;
+    } range[XCP_CAL_DELTA_LOG_SIZE];
+} tCalSegDeltaLog;
+
+static struct {
+    vuint8* xcpPage; // Working page at the segment address, accessed by XCP
+    const vuint8* refPage; // Reference page
+    vuint8* ecuPage[2]; // Published copies of the working page
+    vuint32 size;
+    volatile vuint32 ecuIndex; // Page read by the ECU, 0,1 = ecuPage[], CAL_SEG_REF = refPage
+    vuint32 workIndex; // Most recently published copy of the working page
+    volatile vuint32 readers[3]; // Number of ECU readers of ecuPage[0], ecuPage[1] and refPage
+    vuint8 ecuCalPage; // Page selected for ECU access
+    vuint8 xcpCalPage; // Page selected for XCP access
+    vuint8 transaction; // Calibration transaction open, publishing is deferred until commit
+    tCalSegDeltaLog delta[2]; // Modifications not published yet and modifications published last, missing in the unused copy
+    vuint32 deltaIndex; // Index of the delta log of the modifications not published yet
+} gCalSeg;
+
+int XcpCalSegInit(vuint8* xcpPage, const vuint8* refPage, vuint32 size) {
+
+    vuint8* p = (vuint8*)malloc(2 * size);
+    if (p == NULL) return 0;
+    if (gCalSeg.ecuPage[0] != NULL) free(gCalSeg.ecuPage[0]);
+    memset(&gCalSeg, 0, sizeof(gCalSeg));
+    gCalSeg.xcpPage = xcpPage;
+    gCalSeg.refPage = refPage;
+    gCalSeg.size = size;
+    gCalSeg.ecuPage[0] = p;
+    gCalSeg.ecuPage[1] = p + size;
+    memcpy(gCalSeg.ecuPage[0], xcpPage, size);
+    memcpy(gCalSeg.ecuPage[1], xcpPage, size);
+    return 1;
+}
+
+static const vuint8* calSegPage(vuint32 i) {
+    return i == CAL_SEG_REF ? gCalSeg.refPage : gCalSeg.ecuPage[i];
+}
+
+// Get the page currently selected for the ECU, must be released with XcpCalSegUnlock
+// Never blocks, the page content does not change until XcpCalSegUnlock
+const vuint8* XcpCalSegLock() {
+
+    vuint32 i;
+    for (;;) {
+        i = atomicLoad32(&gCalSeg.ecuIndex);
+        atomicAdd32(&gCalSeg.readers[i], 1);
+        if (atomicLoad32(&gCalSeg.ecuIndex) == i) break;
+        atomicAdd32(&gCalSeg.readers[i], (vuint32)-1); // Published in the meantime, retry
+    }
+    return calSegPage(i);
+}
+
+void XcpCalSegUnlock(const vuint8* page) {
+
+    vuint32 i = (page == gCalSeg.refPage) ? CAL_SEG_REF : (page == gCalSeg.ecuPage[1]) ? 1 : 0;
+    atomicAdd32(&gCalSeg.readers[i], (vuint32)-1);
+}
+
+// Add a modified address range of the working page to the delta log
+static void calSegLogWrite(vuint32 offset, vuint32 size) {
+
+    tCalSegDeltaLog* log = &gCalSeg.delta[gCalSeg.deltaIndex];
+
+    if (log->overflow) return;
+    if (log->count > 0 && log->range[log->count - 1].offset + log->range[log->count - 1].size == offset) { // Continues the previous range
+        log->range[log->count - 1].size += size;
+    }
+    else if (log->count < XCP_CAL_DELTA_LOG_SIZE) {
+        log->range[log->count].offset = offset;
+        log->range[log->count].size = size;
+        log->count++;
+    }
+    else {
+        log->overflow = 1;
+    }
+}
+
+// Copy the logged address ranges of the working page
+static void calSegApply(vuint8* page, const tCalSegDeltaLog* log) {
+
+    vuint32 i;
+
+    if (log->overflow) {
+        memcpy(page, gCalSeg.xcpPage, gCalSeg.size);
+        return;
+    }
+    for (i = 0; i < log->count; i++) {
+        memcpy(page + log->range[i].offset, gCalSeg.xcpPage + log->range[i].offset, log->range[i].size);
+    }
+}
+
+// Update the unused copy with the modifications of the working page and make it visible to the ECU
+// Called by the command processor after a download command, deferred during a transaction
+void ApplXcpCalSegPublish() {
+
+    tCalSegDeltaLog* cur = &gCalSeg.delta[gCalSeg.deltaIndex];
+    tCalSegDeltaLog* prev = &gCalSeg.delta[gCalSeg.deltaIndex ^ 1];
+    vuint32 i;
+
+    if (gCalSeg.transaction) return;
+    if (cur->count == 0 && !cur->overflow) return; // Not modified
+    i = gCalSeg.workIndex ^ 1;
+    while (atomicLoad32(&gCalSeg.readers[i]) != 0) sleepNs(10000); // Wait until the last reader of the previous copy has left
+    calSegApply(gCalSeg.ecuPage[i], prev); // Published to the other copy last time
+    calSegApply(gCalSeg.ecuPage[i], cur);
+    gCalSeg.workIndex = i;
+    if (gCalSeg.ecuCalPage == 0) atomicStore32(&gCalSeg.ecuIndex, i);
+    prev->count = 0;
+    prev->overflow = 0;
+    gCalSeg.deltaIndex ^= 1;
+#ifdef XCP_ENABLE_CAL_STORE
+    calStoreUpdate(); // Persist the published calibration
+#endif
+}
+
+// Begin a calibration transaction, all following downloads become visible to the ECU at once on commit
+vuint8 ApplXcpCalSegBegin() {
+
+    if (gCalSeg.transaction) return CRC_SEQUENCE;
+    gCalSeg.transaction = 1;
+    return 0;
+}
+
+vuint8 ApplXcpCalSegCommit() {
+
+    if (!gCalSeg.transaction) return CRC_SEQUENCE;
+    gCalSeg.transaction = 0;
+    ApplXcpCalSegPublish();
+    return 0;
+}
+
+// Check a XCP write access, the reference page is read only
+// Returns 0, if denied
+vuint8 ApplXcpCheckWriteAccess(const vuint8* p, vuint8 size) {
+
+    if (gCalSeg.size == 0) return 1;
+    if (p + size > gCalSeg.refPage && p < gCalSeg.refPage + gCalSeg.size) return 0;
+    if (p >= gCalSeg.xcpPage && p + size <= gCalSeg.xcpPage + gCalSeg.size) {
+        calSegLogWrite((vuint32)(p - gCalSeg.xcpPage), size);
+    }
+    else if (p + size > gCalSeg.xcpPage && p < gCalSeg.xcpPage + gCalSeg.size) { // Partially inside
+        gCalSeg.delta[gCalSeg.deltaIndex].overflow = 1;
+    }
+    return 1;
+}
+
+// Redirect XCP accesses to the segment address to the reference page, if the reference page is selected for XCP access
+static vuint8* calSegGetPointer(vuint8* p) {
+
+    if (gCalSeg.xcpCalPage == 1 && p >= gCalSeg.xcpPage && p < gCalSeg.xcpPage + gCalSeg.size) return (vuint8*)gCalSeg.refPage + (p - gCalSeg.xcpPage);
+    return p;
+}
 
 vuint8 ApplXcpGetCalPage(vuint8 segment, vuint8 mode) {
-    return calPage;
+
+    return (mode & CAL_ECU) ? gCalSeg.ecuCalPage : gCalSeg.xcpCalPage;
 }
 
 vuint8 ApplXcpSetCalPage(vuint8 segment, vuint8 page, vuint8 mode) {
-    calPage = page;
+
+    if (page > 1) return CRC_PAGE_NOT_VALID;
+    if (mode & CAL_ECU) {
+        gCalSeg.ecuCalPage = page;
+        if (page == 0) {
+            ApplXcpCalSegPublish(); // Modifications made while the ECU was on the reference page
+            atomicStore32(&gCalSeg.ecuIndex, gCalSeg.workIndex);
+        }
+        else {
+            atomicStore32(&gCalSeg.ecuIndex, CAL_SEG_REF);
+        }
+    }
+    if (mode & CAL_XCP) gCalSeg.xcpCalPage = page;
     return 0;
-  }
+}
+
+#endif
+
+#ifdef XCP_ENABLE_CAL_STORE
+
+// STORE_CAL_REQ, persist the calibration without delay
+// Denied during a calibration transaction, the working page contains modifications not committed yet
+vuint8 ApplXcpCalStoreRequest() {
+
+#ifdef XCP_ENABLE_CAL_PAGE
+    if (gCalSeg.transaction) return CRC_SEQUENCE;
+#endif
+    calStoreRequest();
+    return 0;
+}
+
 #endif
 
 
@@ -73,6 +73,21 @@ extern vuint16 XcpCreateEvent(const char* name, vuint16 timeCycle /*ms */, vuint
 
 
 
+/*----------------------------------------------------------------------------*/
+// Calibration segment with working and reference page
+
+#ifdef XCP_ENABLE_CAL_PAGE
+
+// Register the calibration segment, xcpPage is the working page at the segment address
+extern int XcpCalSegInit(vuint8* xcpPage, const vuint8* refPage, vuint32 size);
+
+// Get a consistent copy of the page selected for the ECU, lock free, must be released with XcpCalSegUnlock
+extern const vuint8* XcpCalSegLock();
+extern void XcpCalSegUnlock(const vuint8* page);
+
+#endif
+
+
 /*----------------------------------------------------------------------------*/
 // DAQ clock provided to xcpLite.c as macros
 
@@ -96,17 +111,89 @@ extern vuint16 XcpCreateEvent(const char* name, vuint16 timeCycle /*ms */, vuint
 #define ApplXcpSetClusterId(id) 
 #endif
 
+#ifdef XCPTL_ENABLE_SHM
+
 // Get and commit buffer space for a DAQ DTO message
-#define ApplXcpGetDtoBuffer udpTlGetPacketBuffer
-#define ApplXcpCommitDtoBuffer udpTlCommitPacketBuffer
+#define ApplXcpTlGetDtoBuffer shmTlGetPacketBuffer
+#define ApplXcpTlCommitDtoBuffer shmTlCommitPacketBuffer
+
+// Get and commit buffer space for all DAQ DTO messages of an event
+#define ApplXcpTlGetDtoBuffers shmTlGetPacketBuffers
+#define ApplXcpTlCommitDtoBuffers shmTlCommitPacketBuffers
+
+// Start stop DAQ
+#define ApplXcpTlDaqStart shmTlInitTransmitQueue
+#define ApplXcpDaqStop shmTlInitTransmitQueue
+
+// Send a CRM message
+#define ApplXcpSendCrm shmTlSendCrmPacket
+
+#else
+
+// Get and commit buffer space for a DAQ DTO message
+#define ApplXcpTlGetDtoBuffer udpTlGetPacketBuffer
+#define ApplXcpTlCommitDtoBuffer udpTlCommitPacketBuffer
+
+// Get and commit buffer space for all DAQ DTO messages of an event
+#define ApplXcpTlGetDtoBuffers udpTlGetPacketBuffers
+#define ApplXcpTlCommitDtoBuffers udpTlCommitPacketBuffers
 
 // Start stop DAQ
-#define ApplXcpDaqStart udpTlInitTransmitQueue
+#define ApplXcpTlDaqStart udpTlInitTransmitQueue
 #define ApplXcpDaqStop udpTlInitTransmitQueue
 
 // Send a CRM message
 #define ApplXcpSendCrm udpTlSendCrmPacket
 
+#endif
+
+#if defined(XCP_ENABLE_MDF_RECORDER)
+
+#ifdef XCP_ENABLE_DAQ_RECORDER
+#error "XCP_ENABLE_DAQ_RECORDER and XCP_ENABLE_MDF_RECORDER can not be combined"
+#endif
+
+// DAQ DTO messages are routed to the MDF recorder while it is recording
+#define ApplXcpGetDtoBuffer mdfGetDtoBuffer
+#define ApplXcpCommitDtoBuffer mdfCommitDtoBuffer
+#define ApplXcpGetDtoBuffers mdfGetDtoBuffers
+#define ApplXcpCommitDtoBuffers mdfCommitDtoBuffers
+#define ApplXcpDaqStart ApplXcpTlDaqStart
+
+// A XCP master can not connect while recording
+#define ApplXcpConnect mdfConnect
+
+#elif defined(XCP_ENABLE_DAQ_RECORDER)
+
+// DAQ DTO messages are routed through the pre-trigger recorder
+#define ApplXcpGetDtoBuffer recGetDtoBuffer
+#define ApplXcpCommitDtoBuffer recCommitDtoBuffer
+#define ApplXcpGetDtoBuffers recGetDtoBuffers
+#define ApplXcpCommitDtoBuffers recCommitDtoBuffers
+#define ApplXcpDaqStart recDaqStart
+
+// Recorder control by XCP user commands
+#define ApplXcpRecArm recArm
+#define ApplXcpRecTrigger recTrigger
+#define ApplXcpRecStop recStop
+
+#else
+
+#define ApplXcpGetDtoBuffer ApplXcpTlGetDtoBuffer
+#define ApplXcpCommitDtoBuffer ApplXcpTlCommitDtoBuffer
+#define ApplXcpGetDtoBuffers ApplXcpTlGetDtoBuffers
+#define ApplXcpCommitDtoBuffers ApplXcpTlCommitDtoBuffers
+#define ApplXcpDaqStart ApplXcpTlDaqStart
+
+#endif
+
+#ifdef XCP_ENABLE_CAL_STORE
+
+// Calibration store control by SET_REQUEST STORE_CAL_REQ and GET_STATUS
+#define ApplXcpCalStorePending calStorePending
+
+#endif
+
 
 
 #ifdef __cplusplus
@@ -0,0 +1,312 @@
+/*----------------------------------------------------------------------------
+| File:
+|   xcpCalStore.c
+|
+| Description:
+|   Persistent calibration store
+|   The registered memory ranges are stored in a memory mapped file with two image slots, written alternately
+|   Each image has a header with layout version, sequence number and checksum
+|   Modifications are copied to a snapshot on the command path, the snapshot is written to the file by the calibration store thread
+|   On startup, the valid image with the highest sequence number is restored
+|
+| Copyright (c) Vector Informatik GmbH. All rights reserved.
+| Licensed under the MIT license. See LICENSE file in the project root for details.
+|
+ ----------------------------------------------------------------------------*/
+
+#include "configuration.h"
+#include "xcpAppl.h"
+
+#ifdef XCP_ENABLE_CAL_STORE
+
+#ifdef _LINUX
+#include <sys/mman.h>
+#endif
+
+#define CAL_STORE_MAGIC 0x4C414358 // "XCAL"
+#define CAL_STORE_ALIGNMENT 4096 // Image slot alignment in the file
+#define CAL_STORE_SLOT_SIZE(n) (((uint32_t)sizeof(tCalStoreHeader) + (n) + (CAL_STORE_ALIGNMENT-1)) & ~(uint32_t)(CAL_STORE_ALIGNMENT-1))
+
+static struct {
+
+    // Registered memory ranges
+    struct {
+        vuint8* addr;
+        uint32_t size;
+    } seg[XCP_CAL_STORE_MAX_SEGMENTS];
+    uint32_t count;
+    uint32_t size; // Sum of all memory range sizes
+    uint32_t version;
+
+    // Memory mapped file, protected by fileMutex
+    uint8_t* volatile file;
+    uint32_t slotSize;
+    uint32_t slot; // Image slot written next
+    uint32_t sequence; // Sequence number of the last image written
+#ifdef _WIN
+    HANDLE hFile;
+#endif
+    MUTEX fileMutex;
+
+    // Snapshot of the registered memory ranges, protected by mutex
+    uint8_t* snapshot;
+    uint64_t updateTime; // Clock of the last snapshot
+    volatile uint32_t pending; // Snapshot not written yet
+    volatile uint32_t request; // Number of STORE_CAL_REQ not completed yet, written without delay
+    MUTEX mutex;
+
+} gCalStore;
+
+static uint32_t gCalStoreCrcTable[256];
+
+
+// CRC32, IEEE 802.3
+static uint32_t calStoreCrc(const uint8_t* p, uint32_t n) {
+
+    uint32_t crc = 0xFFFFFFFF;
+    while (n-- > 0) crc = (crc >> 8) ^ gCalStoreCrcTable[(crc ^ *p++) & 0xFF];
+    return crc ^ 0xFFFFFFFF;
+}
+
+// Map the store file, resize it if the layout has changed
+static uint8_t* calStoreMap(const char* filename, uint32_t size) {
+
+    uint8_t* p;
+
+#ifdef _WIN
+    HANDLE hMap;
+    gCalStore.hFile = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (gCalStore.hFile == INVALID_HANDLE_VALUE) {
+        printf("ERROR: cannot open calibration store %s!\n", filename);
+        return NULL;
+    }
+    hMap = CreateFileMappingA(gCalStore.hFile, NULL, PAGE_READWRITE, 0, size, NULL); // Extends the file
+    p = (hMap == NULL) ? NULL : (uint8_t*)MapViewOfFile(hMap, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (hMap != NULL) CloseHandle(hMap); // The view keeps the mapping
+    if (p == NULL) {
+        printf("ERROR: cannot map calibration store %s (error=%u)!\n", filename, (uint32_t)GetLastError());
+        CloseHandle(gCalStore.hFile);
+        return NULL;
+    }
+#else
+    struct stat st;
+    int fd = open(filename, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        printf("ERROR: cannot open calibration store %s (errno=%d)!\n", filename, errno);
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || (st.st_size != (off_t)size && ftruncate(fd, size) != 0)) {
+        printf("ERROR: cannot resize calibration store %s (errno=%d)!\n", filename, errno);
+        close(fd);
+        return NULL;
+    }
+    p = (uint8_t*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file
+    if (p == (uint8_t*)MAP_FAILED) {
+        printf("ERROR: cannot map calibration store %s (errno=%d)!\n", filename, errno);
+        return NULL;
+    }
+#endif
+    return p;
+}
+
+// Write the modified pages of the mapped file to disk
+static void calStoreFlush() {
+
+#ifdef _WIN
+    FlushViewOfFile(gCalStore.file, 2 * gCalStore.slotSize);
+    FlushFileBuffers(gCalStore.hFile);
+#else
+    msync(gCalStore.file, 2 * gCalStore.slotSize, MS_SYNC);
+#endif
+}
+
+// Write the snapshot to the next image slot, fileMutex must be locked
+// Data first, header last, an interrupted write leaves an image with an invalid checksum and the other slot is restored
+static void calStoreWrite() {
+
+    tCalStoreHeader* h = (tCalStoreHeader*)(gCalStore.file + gCalStore.slot * gCalStore.slotSize);
+    uint8_t* d = (uint8_t*)(h + 1);
+    uint32_t request;
+
+    mutexLock(&gCalStore.mutex);
+    memcpy(d, gCalStore.snapshot, gCalStore.size);
+    gCalStore.pending = 0;
+    request = gCalStore.request;
+    mutexUnlock(&gCalStore.mutex);
+    calStoreFlush();
+
+    h->magic = CAL_STORE_MAGIC;
+    h->version = gCalStore.version;
+    h->size = gCalStore.size;
+    h->checksum = calStoreCrc(d, gCalStore.size);
+    h->sequence = ++gCalStore.sequence;
+    calStoreFlush();
+
+    gCalStore.slot ^= 1;
+    if (request > 0) atomicAdd32(&gCalStore.request, (uint32_t)-(int32_t)request); // STORE_CAL_REQ completed
+    if (gDebugLevel >= 2) printf("Calibration stored (slot=%u, sequence=%u)\n", gCalStore.slot ^ 1, gCalStore.sequence);
+}
+
+// Copy the registered memory ranges to the snapshot
+static void calStoreSnapshot(uint32_t request) {
+
+    uint8_t* d;
+    uint32_t i;
+
+    if (gCalStore.file == NULL) return;
+    mutexLock(&gCalStore.mutex);
+    if (gCalStore.file != NULL) { // Not closed in the meantime
+        d = gCalStore.snapshot;
+        for (i = 0; i < gCalStore.count; i++) {
+            memcpy(d, gCalStore.seg[i].addr, gCalStore.seg[i].size);
+            d += gCalStore.seg[i].size;
+        }
+        gCalStore.updateTime = clockGet64();
+        gCalStore.pending = 1;
+        gCalStore.request += request;
+    }
+    mutexUnlock(&gCalStore.mutex);
+}
+
+
+//------------------------------------------------------------------------------
+
+int calStoreRegister(vuint8* addr, vuint32 size) {
+
+    if (gCalStore.file != NULL || gCalStore.count >= XCP_CAL_STORE_MAX_SEGMENTS) {
+        printf("ERROR: cannot register calibration store memory range!\n");
+        return 0;
+    }
+    gCalStore.seg[gCalStore.count].addr = addr;
+    gCalStore.seg[gCalStore.count].size = size;
+    gCalStore.count++;
+    gCalStore.size += size;
+    return 1;
+}
+
+int calStoreOpen(const char* filename, uint32_t version) {
+
+    const tCalStoreHeader* h;
+    const tCalStoreHeader* best = NULL;
+    const uint8_t* d;
+    uint8_t* p;
+    uint32_t i, j, c;
+    uint64_t t = clockGet64();
+
+    if (gCalStore.file != NULL || gCalStore.count == 0) return 0;
+
+    for (i = 0; i < 256; i++) {
+        c = i;
+        for (j = 0; j < 8; j++) c = (c & 1) ? (c >> 1) ^ 0xEDB88320 : c >> 1;
+        gCalStoreCrcTable[i] = c;
+    }
+
+    gCalStore.version = version;
+    gCalStore.slotSize = CAL_STORE_SLOT_SIZE(gCalStore.size);
+    gCalStore.snapshot = (uint8_t*)malloc(gCalStore.size);
+    if (gCalStore.snapshot == NULL) return 0;
+    p = calStoreMap(filename, 2 * gCalStore.slotSize);
+    if (p == NULL) {
+        free(gCalStore.snapshot);
+        gCalStore.snapshot = NULL;
+        return 0;
+    }
+
+    // Find the valid image with the highest sequence number
+    for (i = 0; i < 2; i++) {
+        h = (const tCalStoreHeader*)(p + i * gCalStore.slotSize);
+        if (h->magic != CAL_STORE_MAGIC || h->version != version || h->size != gCalStore.size) continue;
+        if (calStoreCrc((const uint8_t*)(h + 1), h->size) != h->checksum) {
+            printf("WARNING: calibration store image %u in %s is corrupt!\n", i, filename);
+            continue;
+        }
+        if (best == NULL || (int32_t)(h->sequence - best->sequence) > 0) best = h;
+    }
+
+    // Restore the registered memory ranges
+    if (best != NULL) {
+        d = (const uint8_t*)(best + 1);
+        for (i = 0; i < gCalStore.count; i++) {
+            memcpy(gCalStore.seg[i].addr, d, gCalStore.seg[i].size);
+            d += gCalStore.seg[i].size;
+        }
+        gCalStore.sequence = best->sequence;
+        gCalStore.slot = ((const uint8_t*)best == p) ? 1 : 0;
+    }
+    else {
+        gCalStore.sequence = 0;
+        gCalStore.slot = 0;
+    }
+
+    mutexInit(&gCalStore.mutex, 0, 1000);
+    mutexInit(&gCalStore.fileMutex, 0, 1000);
+    gCalStore.pending = gCalStore.request = 0;
+    gCalStore.file = p;
+    calStoreSnapshot(0);
+    gCalStore.pending = 0; // Snapshot equals the file content or the defaults
+
+    if (best != NULL) {
+        printf("Restored calibration from %s (size=%u, sequence=%u, %uus)\n", filename, gCalStore.size, gCalStore.sequence, (uint32_t)((clockGet64() - t) / CLOCK_TICKS_PER_US));
+    }
+    else {
+        printf("Init calibration store %s (size=%u), no valid image, defaults used\n", filename, gCalStore.size);
+    }
+    return best != NULL;
+}
+
+void calStoreClose() {
+
+    uint8_t* p;
+
+    if (gCalStore.file == NULL) return;
+    mutexLock(&gCalStore.fileMutex);
+    if (gCalStore.pending) calStoreWrite(); // Flush without delay
+    mutexLock(&gCalStore.mutex);
+    p = gCalStore.file;
+    gCalStore.file = NULL;
+    free(gCalStore.snapshot);
+    gCalStore.snapshot = NULL;
+    gCalStore.request = 0;
+    mutexUnlock(&gCalStore.mutex);
+#ifdef _WIN
+    UnmapViewOfFile(p);
+    CloseHandle(gCalStore.hFile);
+#else
+    munmap(p, 2 * gCalStore.slotSize);
+#endif
+    mutexUnlock(&gCalStore.fileMutex);
+}
+
+void calStoreUpdate() {
+
+    calStoreSnapshot(0);
+}
+
+void calStoreRequest() {
+
+    calStoreSnapshot(1);
+}
+
+int calStorePending() {
+
+    return atomicLoad32(&gCalStore.request) != 0;
+}
+
+// Write the snapshot, when there was no modification for XCP_CAL_STORE_DELAY_MS or on STORE_CAL_REQ
+int calStoreHandle() {
+
+    int r = 0;
+
+    if (gCalStore.file == NULL) return 0;
+    mutexLock(&gCalStore.fileMutex);
+    if (gCalStore.file != NULL && atomicLoad32(&gCalStore.pending) &&
+        (atomicLoad32(&gCalStore.request) != 0 || clockGet64() - gCalStore.updateTime >= (uint64_t)XCP_CAL_STORE_DELAY_MS * CLOCK_TICKS_PER_MS)) {
+        calStoreWrite();
+        r = 1;
+    }
+    mutexUnlock(&gCalStore.fileMutex);
+    return r;
+}
+
+#endif
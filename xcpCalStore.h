@@ -0,0 +1,52 @@
+/* xcpCalStore.h */
+
+/* Copyright(c) Vector Informatik GmbH.All rights reserved.
+   Licensed under the MIT license.See LICENSE file in the project root for details. */
+
+#ifndef __XCPCALSTORE_H__
+#define __XCPCALSTORE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef XCP_ENABLE_CAL_STORE
+
+// Image header, the file contains two image slots, the valid image with the highest sequence number is restored
+typedef struct {
+    uint32_t magic; // CAL_STORE_MAGIC
+    uint32_t version; // Layout version of the application
+    uint32_t size; // Size of the data following the header
+    uint32_t sequence; // Incremented with each image written
+    uint32_t checksum; // CRC32 of the data
+    uint32_t res[3];
+} tCalStoreHeader;
+
+// Register memory ranges to be persisted, before calStoreOpen
+extern int calStoreRegister(vuint8* addr, vuint32 size);
+
+// Map the store file and restore the registered memory ranges from the last consistent image
+// Returns 1, if restored, 0 if the defaults are kept
+extern int calStoreOpen(const char* filename, uint32_t version);
+
+// Flush pending modifications and unmap the store file
+extern void calStoreClose();
+
+// Snapshot the registered memory ranges, written to the file asynchronously by calStoreHandle
+extern void calStoreUpdate();
+
+// Snapshot and write immediately, calStorePending is true until the image is written
+extern void calStoreRequest();
+extern int calStorePending();
+
+// Write the snapshot to the file, called cyclically by the calibration store thread
+// Returns 1, if an image has been written
+extern int calStoreHandle();
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
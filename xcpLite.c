@@ -11,7 +11,7 @@
 |
 |  Supported commands:
 |   GET_COMM_MODE_INFO GET_ID GET_VERSION
-|   SET_MTA UPLOAD SHORT_UPLOAD DOWNLOAD SHORT_DOWNLOAD
+|   SET_MTA UPLOAD SHORT_UPLOAD DOWNLOAD DOWNLOAD_NEXT SHORT_DOWNLOAD
 |   GET_CAL_PAGE SET_CAL_PAGE BUILD_CHECKSUM
 |   GET_DAQ_RESOLUTION_INFO GET_DAQ_PROCESSOR_INFO GET_DAQ_EVENT_INFO GET_DAQ_LIST_INFO
 |   FREE_DAQ ALLOC_DAQ ALLOC_ODT ALLOC_ODT_ENTRY SET_DAQ_PTR WRITE_DAQ WRITE_DAQ_MULTIPLE
@@ -25,12 +25,12 @@
 |     - No misra compliance
 |     - Overall number of ODTs limited to 64K
 |     - Overall number of ODT entries is limited to 64K
-|     - Fixed DAQ+ODT 2 byte DTO header
+|     - DAQ+ODT 2 byte DTO header or ODT,FIL,DAQW 4 byte DTO header
 |     - Fixed 32 bit time stamp
 |     - Only dynamic DAQ list allocation supported
 |     - Resume is not supported
 |     - Overload indication by event is not supported
-|     - DAQ does not support address extensions and prescaler
+|     - DAQ does not support address extensions
 |     - DAQ list and event channel prioritization is not supported
 |     - ODT optimization not supported
 |     - Interleaved communication mode is not supported
@@ -63,6 +63,14 @@
 #include "xcpAppl.h"  /* External dependencies */
 #include "xcpLite.h"
 
+#if ( defined ( XCP_ENABLE_DAQ_GATHER ) || defined ( XCP_ENABLE_CHECKSUM ) ) && ( defined ( __x86_64__ ) || defined ( _M_X64 ) )
+  #define XCP_ENABLE_AVX2
+  #include <immintrin.h>
+  #ifdef _MSC_VER
+    #include <intrin.h>
+  #endif
+#endif
+
 
 /****************************************************************************/
 /* Global data                                                               */
@@ -81,6 +89,7 @@ tXcpData gXcp;
 
 #define isConnected() (gXcp.SessionStatus & SS_CONNECTED)
 #define isDaqRunning() (gXcp.SessionStatus & SS_DAQ)
+#define isEventActive(e) ((e) < XCP_MAX_EVENT && gXcp.EventDaqFirst[e] != XCP_UNDEFINED_DAQ_LIST)
 
 
 /****************************************************************************/
@@ -110,6 +119,14 @@ vuint16 XcpGetClusterId() {
     return gXcp.ClusterId;
 }
 
+vuint32 XcpGetDaqOverflowCount() {
+    return atomicLoad32(&gXcp.DaqOverflowCount);
+}
+
+vuint32 XcpGetEventOverflowCount(vuint16 event) {
+    return event < XCP_MAX_EVENT ? atomicLoad32(&gXcp.EventOverflowCount[event]) : 0;
+}
+
 vuint8 XcpIsDaqPacked() {
 #ifdef XCP_ENABLE_PACKED_MODE
     for (vuint16 daq = 0; daq < gXcp.Daq.DaqCount; daq++) {
@@ -127,14 +144,13 @@ vuint8 XcpIsDaqPacked() {
 // Write n bytes. Copying of size bytes from data to gXcp.Mta
 vuint8  XcpWriteMta( vuint8 size, const vuint8* data )
 {
+#ifdef XCP_ENABLE_CAL_PAGE
+  if (!ApplXcpCheckWriteAccess(gXcp.Mta, size)) return XCP_CMD_DENIED;
+#endif
 
   /* Standard RAM memory write access */
-  while ( size > 0 )  {
-    *gXcp.Mta = *data;
-    gXcp.Mta++; 
-    data++; 
-    size--;
-  }
+  memcpy(gXcp.Mta, data, size);
+  gXcp.Mta += size;
   return XCP_CMD_OK;
   
 }
@@ -143,26 +159,168 @@ vuint8  XcpWriteMta( vuint8 size, const vuint8* data )
 vuint8  XcpReadMta( vuint8 size, vuint8* data )
 {
   /* Standard RAM memory read access */
-  while (size > 0)  {
-    *data = *gXcp.Mta;
-    data++; 
-    gXcp.Mta++; 
-    size--;
-  }
+  memcpy(data, gXcp.Mta, size);
+  gXcp.Mta += size;
   return XCP_CMD_OK;
 }
 
 
+#ifdef XCP_ENABLE_CHECKSUM
+
+#if XCP_CHECKSUM_TYPE != XCP_CHECKSUM_TYPE_ADD44 && XCP_CHECKSUM_TYPE != XCP_CHECKSUM_TYPE_ADD14 && XCP_CHECKSUM_TYPE != XCP_CHECKSUM_TYPE_CRC16CCITT && XCP_CHECKSUM_TYPE != XCP_CHECKSUM_TYPE_CRC32
+#error "XCP_CHECKSUM_TYPE not supported"
+#endif
+
+#ifdef XCP_ENABLE_AVX2
+
+// ADD_44, add n/4 DWORDs, 8 DWORDs per AVX2 instruction
+#ifndef _MSC_VER
+__attribute__((target("avx2")))
+#endif
+static vuint32 XcpChecksumAdd44Avx2(const vuint8* p, vuint32 n)
+{
+  __m256i v = _mm256_setzero_si256();
+  vuint32 s[8], d, i;
+  for (i = 0; i + 32 <= n; i += 32) v = _mm256_add_epi32(v, _mm256_loadu_si256((const __m256i*)&p[i]));
+  _mm256_storeu_si256((__m256i*)s, v);
+  s[0] += s[1] + s[2] + s[3] + s[4] + s[5] + s[6] + s[7];
+  for (; i < n; i += 4) { memcpy(&d, &p[i], 4); s[0] += d; }
+  return s[0];
+}
+
+// ADD_14, add n bytes, 32 bytes per AVX2 sum of absolute differences instruction
+#ifndef _MSC_VER
+__attribute__((target("avx2")))
+#endif
+static vuint32 XcpChecksumAdd14Avx2(const vuint8* p, vuint32 n)
+{
+  __m256i v = _mm256_setzero_si256();
+  vuint64 s[4];
+  vuint32 i;
+  for (i = 0; i + 32 <= n; i += 32) v = _mm256_add_epi64(v, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i*)&p[i]), _mm256_setzero_si256()));
+  _mm256_storeu_si256((__m256i*)s, v);
+  s[0] += s[1] + s[2] + s[3];
+  for (; i < n; i++) s[0] += p[i];
+  return (vuint32)s[0];
+}
+
+#endif
+
+// ADD_44, add DWORDs into a DWORD, n must be a multiple of 4
+static vuint32 XcpChecksumAdd44(const vuint8* p, vuint32 n)
+{
+  vuint32 s[4] = { 0,0,0,0 }, d[4], i;
+#ifdef XCP_ENABLE_AVX2
+  if (gXcp.CpuAvx2) return XcpChecksumAdd44Avx2(p, n);
+#endif
+  for (i = 0; i + 16 <= n; i += 16) { memcpy(d, &p[i], 16); s[0] += d[0]; s[1] += d[1]; s[2] += d[2]; s[3] += d[3]; }
+  for (; i < n; i += 4) { memcpy(d, &p[i], 4); s[0] += d[0]; }
+  return s[0] + s[1] + s[2] + s[3];
+}
+
+// ADD_14, add bytes into a DWORD
+static vuint32 XcpChecksumAdd14(const vuint8* p, vuint32 n)
+{
+  vuint32 s = 0, i;
+#ifdef XCP_ENABLE_AVX2
+  if (gXcp.CpuAvx2) return XcpChecksumAdd14Avx2(p, n);
+#endif
+  for (i = 0; i < n; i++) s += p[i];
+  return s;
+}
+
+static vuint16 gXcpCrc16Table[256];
+
+// CRC_16_CITT, polynomial 0x1021, initial value 0xFFFF, not reflected, one table lookup per byte
+static vuint32 XcpChecksumCrc16(const vuint8* p, vuint32 n)
+{
+  vuint16 crc = 0xFFFF;
+  vuint32 i, j;
+  if (gXcpCrc16Table[1] == 0) {
+    for (i = 0; i < 256; i++) {
+      crc = (vuint16)(i << 8);
+      for (j = 0; j < 8; j++) crc = (vuint16)((crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1);
+      gXcpCrc16Table[i] = crc;
+    }
+    crc = 0xFFFF;
+  }
+  for (i = 0; i < n; i++) crc = (vuint16)((crc << 8) ^ gXcpCrc16Table[((crc >> 8) ^ p[i]) & 0xFF]);
+  return crc;
+}
+
+static vuint32 gXcpCrc32Table[8][256];
+
+// CRC_32, IEEE 802.3 polynomial 0x04C11DB7 reflected, initial value and final xor 0xFFFFFFFF
+// Slicing by 8, one table lookup per byte without dependency on the previous byte
+static vuint32 XcpChecksumCrc32(const vuint8* p, vuint32 n)
+{
+  vuint32 crc, a, b, i, j;
+  if (gXcpCrc32Table[0][1] == 0) {
+    for (i = 0; i < 256; i++) {
+      crc = i;
+      for (j = 0; j < 8; j++) crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+      gXcpCrc32Table[0][i] = crc;
+    }
+    for (i = 0; i < 256; i++) {
+      for (j = 1; j < 8; j++) gXcpCrc32Table[j][i] = (gXcpCrc32Table[j - 1][i] >> 8) ^ gXcpCrc32Table[0][gXcpCrc32Table[j - 1][i] & 0xFF];
+    }
+  }
+  crc = 0xFFFFFFFF;
+  for (i = 0; i + 8 <= n; i += 8) {
+    memcpy(&a, &p[i], 4);
+    memcpy(&b, &p[i + 4], 4);
+    a ^= crc;
+    crc = gXcpCrc32Table[7][a & 0xFF] ^ gXcpCrc32Table[6][(a >> 8) & 0xFF] ^ gXcpCrc32Table[5][(a >> 16) & 0xFF] ^ gXcpCrc32Table[4][a >> 24] ^
+          gXcpCrc32Table[3][b & 0xFF] ^ gXcpCrc32Table[2][(b >> 8) & 0xFF] ^ gXcpCrc32Table[1][(b >> 16) & 0xFF] ^ gXcpCrc32Table[0][b >> 24];
+  }
+  for (; i < n; i++) crc = (crc >> 8) ^ gXcpCrc32Table[0][(crc ^ p[i]) & 0xFF];
+  return crc ^ 0xFFFFFFFF;
+}
+
+// Checksum of type XCP_CHECKSUM_TYPE_xxx, BUILD_CHECKSUM uses the constant XCP_CHECKSUM_TYPE, the benchmark all types
+static vuint32 XcpChecksum(vuint8 type, const vuint8* p, vuint32 n)
+{
+  switch (type) {
+  case XCP_CHECKSUM_TYPE_ADD14: return XcpChecksumAdd14(p, n);
+  case XCP_CHECKSUM_TYPE_CRC16CCITT: return XcpChecksumCrc16(p, n);
+  case XCP_CHECKSUM_TYPE_CRC32: return XcpChecksumCrc32(p, n);
+  default: return XcpChecksumAdd44(p, n);
+  }
+}
+
+#endif // XCP_ENABLE_CHECKSUM
+
+
 
 /****************************************************************************/
 /* Data Aquisition Setup                                                    */
 /****************************************************************************/
 
+// Build the chains of running DAQ lists for each event, must be called after the running state of any DAQ list changed
+// XcpEvent_ only visits the DAQ lists of its event
+// Chains are updated in place, an event running concurrently may see the old chain, running state is checked again in XcpEvent_
+static void XcpUpdateEventDaqLists( void )
+{
+  vuint16 first[XCP_MAX_EVENT];
+  vuint16 daq, event;
+
+  for (event = 0; event < XCP_MAX_EVENT; event++) first[event] = XCP_UNDEFINED_DAQ_LIST;
+  for (daq = gXcp.Daq.DaqCount; daq-- > 0;) { // Build chains in ascending DAQ list order
+    if ((DaqListFlags(daq) & (vuint8)DAQ_FLAG_RUNNING) == 0) continue;
+    event = DaqListEventChannel(daq);
+    if (event >= XCP_MAX_EVENT) continue;
+    DaqListNext(daq) = first[event];
+    first[event] = daq;
+  }
+  for (event = 0; event < XCP_MAX_EVENT; event++) gXcp.EventDaqFirst[event] = first[event];
+}
+
 // Free all dynamic DAQ lists
 void  XcpFreeDaq( void )
 {
   ApplXcpDaqStop();
   gXcp.SessionStatus &= (vuint8)(~SS_DAQ);
+  for (vuint16 event = 0; event < XCP_MAX_EVENT; event++) gXcp.EventDaqFirst[event] = XCP_UNDEFINED_DAQ_LIST;
 
   gXcp.Daq.DaqCount = 0;
   gXcp.Daq.OdtCount = 0;
@@ -171,29 +329,120 @@ void  XcpFreeDaq( void )
   gXcp.pOdt = (tXcpOdt*)0;
   gXcp.pOdtEntryAddr = 0;
   gXcp.pOdtEntrySize = 0;
+  gXcp.pCopyOp = 0;
+  gXcp.CopyPlanValid = 0;
 
-  memset((vuint8*)&gXcp.Daq.u.b[0], 0, XCP_DAQ_MEM_SIZE);  
+  // The dynamic DAQ memory is kept for the next configuration, event threads may still be about to leave XcpEvent
+  if (XcpDaqMemSize() > 0) memset((vuint8*)&gXcp.Daq.u.b[0], 0, XcpDaqMemSize());
+}
+
+#ifdef XCP_ENABLE_DYNAMIC_DAQ_MEM
+
+#define XcpRebaseDaqPtr(t,p,b) if ((p) != NULL) (p) = (t)((b) + ((vuint8*)(p) - gXcp.Daq.u.b))
+
+// Link of a retired DAQ memory heap allocation, stored behind its aligned DAQ memory
+typedef struct tXcpDaqMemLink {
+  void* mem;
+  struct tXcpDaqMemLink* next;
+} tXcpDaqMemLink;
+
+// Release the retired DAQ memory, no event thread may access DAQ memory anymore
+static void XcpFreeRetiredDaqMemory( void )
+{
+  tXcpDaqMemLink* l = (tXcpDaqMemLink*)gXcp.Daq.pRetiredMem;
+  tXcpDaqMemLink* next;
+  while (l != NULL) {
+    next = l->next;
+    free(l->mem);
+    l = next;
+  }
+  gXcp.Daq.pRetiredMem = NULL;
+}
+
+// Grow the DAQ memory to at least size bytes, content and the pointers into the DAQ memory are preserved
+static vuint8 XcpGrowDaqMemory( vuint32 size )
+{
+  vuint32 n;
+  void* p;
+  vuint8* b;
+
+  if (size <= gXcp.Daq.MemSize) return 0;
+  if (gXcp.SessionStatus & SS_DAQ) return CRC_DAQ_ACTIVE; // Event threads may access the DAQ memory
+
+  // Grow geometrically in cache line multiples to keep the number of copies low during the DAQ setup
+  n = gXcp.Daq.MemSize * 2;
+  if (n < size) n = size;
+  n = (n + XCP_DAQ_MEM_ALIGNMENT - 1) & ~(vuint32)(XCP_DAQ_MEM_ALIGNMENT - 1);
+  if (n > XCP_DAQ_MEM_SIZE) n = XCP_DAQ_MEM_SIZE;
+
+  p = malloc((size_t)n + XCP_DAQ_MEM_ALIGNMENT + sizeof(tXcpDaqMemLink));
+  if (p == NULL) return CRC_MEMORY_OVERFLOW;
+  b = (vuint8*)(((size_t)p + XCP_DAQ_MEM_ALIGNMENT - 1) & ~(size_t)(XCP_DAQ_MEM_ALIGNMENT - 1));
+  memset(b, 0, n);
+  if (gXcp.Daq.pMem != NULL) {
+      memcpy(b, gXcp.Daq.u.b, gXcp.Daq.MemSize);
+      XcpRebaseDaqPtr(tXcpOdt*, gXcp.pOdt, b);
+      XcpRebaseDaqPtr(vuint32*, gXcp.pOdtEntryAddr, b);
+      XcpRebaseDaqPtr(vuint8*, gXcp.pOdtEntrySize, b);
+      XcpRebaseDaqPtr(tXcpCopyOp*, gXcp.pCopyOp, b);
+      // Event threads which passed the DAQ running check before the last stop may still read the old memory, keep it until XcpInit
+      tXcpDaqMemLink* l = (tXcpDaqMemLink*)((vuint8*)gXcp.Daq.pMem + gXcp.Daq.MemSize + XCP_DAQ_MEM_ALIGNMENT);
+      l->mem = gXcp.Daq.pMem;
+      l->next = (tXcpDaqMemLink*)gXcp.Daq.pRetiredMem;
+      gXcp.Daq.pRetiredMem = l;
+  }
+  gXcp.Daq.pMem = p;
+  gXcp.Daq.u.b = b;
+  gXcp.Daq.MemSize = n;
+
+  #ifdef XCP_ENABLE_TESTMODE
+    if ( ApplXcpDebugLevel >= 3) ApplXcpPrint("[XcpGrowDaqMemory] %u Bytes allocated\n",n );
+  #endif
+
+  return 0;
+}
+
+#endif
+
+// Round a DAQ memory offset up to the next cache line aligned address
+// The dynamic DAQ memory is aligned itself, so the offsets do not change when it grows
+static vuint32 XcpDaqMemAlign( vuint32 offset )
+{
+  size_t a = (size_t)gXcp.Daq.u.b + offset;
+  return offset + (vuint32)(((a + XCP_DAQ_MEM_ALIGNMENT - 1) & ~(size_t)(XCP_DAQ_MEM_ALIGNMENT - 1)) - a);
 }
 
 // Allocate Memory for daq,odt,odtEntries and Queue according to DaqCount, OdtCount and OdtEntryCount
+// Layout: DAQ lists, ODTs, ODT entry addresses, ODT entry sizes and the copy plans in separate cache line aligned arrays
 vuint8  XcpAllocMemory( void )
 {
-  vuint32 s;
+  vuint32 s, odtOffset, addrOffset, sizeOffset;
   
   /* Check memory overflow */
-  s = ( gXcp.Daq.DaqCount * (vuint32)sizeof(tXcpDaqList ) + 
-      ( gXcp.Daq.OdtCount * (vuint32)sizeof(tXcpOdt) ) +
-      ( gXcp.Daq.OdtEntryCount * ((vuint32)sizeof(vuint8*) + (vuint32)sizeof(vuint8) ) ) );
+  odtOffset = XcpDaqMemAlign(gXcp.Daq.DaqCount * (vuint32)sizeof(tXcpDaqList));
+  addrOffset = XcpDaqMemAlign(odtOffset + gXcp.Daq.OdtCount * (vuint32)sizeof(tXcpOdt));
+  sizeOffset = XcpDaqMemAlign(addrOffset + gXcp.Daq.OdtEntryCount * (vuint32)sizeof(vuint32));
+  s = sizeOffset + gXcp.Daq.OdtEntryCount * (vuint32)sizeof(vuint8);
   
   if (s>=XCP_DAQ_MEM_SIZE) return CRC_MEMORY_OVERFLOW;
+
+#ifdef XCP_ENABLE_DYNAMIC_DAQ_MEM
+  {
+    // Reserve space for the worst case copy plan, which is one operation per ODT entry, if the limit allows
+    vuint32 n = s + XCP_DAQ_MEM_ALIGNMENT + gXcp.Daq.OdtEntryCount * (vuint32)sizeof(tXcpCopyOp);
+    vuint8 err = XcpGrowDaqMemory(n < XCP_DAQ_MEM_SIZE ? n : XCP_DAQ_MEM_SIZE);
+    if (err) return err;
+  }
+#endif
   
-  gXcp.pOdt = (tXcpOdt*)&gXcp.Daq.u.DaqList[gXcp.Daq.DaqCount];
-  gXcp.pOdtEntryAddr = (vuint32*)&gXcp.pOdt[gXcp.Daq.OdtCount];
-  gXcp.pOdtEntrySize = (vuint8*)&gXcp.pOdtEntryAddr[gXcp.Daq.OdtEntryCount]; 
+  gXcp.pOdt = (tXcpOdt*)&gXcp.Daq.u.b[odtOffset];
+  gXcp.pOdtEntryAddr = (vuint32*)&gXcp.Daq.u.b[addrOffset];
+  gXcp.pOdtEntrySize = (vuint8*)&gXcp.Daq.u.b[sizeOffset]; 
+  gXcp.CopyPlanValid = 0;
   
 
   #ifdef XCP_ENABLE_TESTMODE
-    if ( ApplXcpDebugLevel >= 3) ApplXcpPrint("[XcpAllocMemory] %u of %u Bytes used\n",s,XCP_DAQ_MEM_SIZE );
+    if ( ApplXcpDebugLevel >= 3) ApplXcpPrint("[XcpAllocMemory] %u of %u Bytes used\n",s,XcpDaqMemSize() );
   #endif
 
   return 0;
@@ -205,11 +454,11 @@ vuint8  XcpAllocDaq( vuint16 daqCount )
   if ( (gXcp.Daq.OdtCount!=0) || (gXcp.Daq.OdtEntryCount!=0) )  {
     return CRC_SEQUENCE;
   }
-  if( daqCount == 0 || daqCount>255)  {
+  if( daqCount == 0 || daqCount>XCP_MAX_DAQ_COUNT)  {
     return CRC_OUT_OF_RANGE;
   }
   
-  gXcp.Daq.DaqCount = (vuint8)daqCount;
+  gXcp.Daq.DaqCount = daqCount;
   return XcpAllocMemory();
 }
 
@@ -292,21 +541,195 @@ vuint8  XcpAddOdtEntry(vuint32 addr, vuint8 ext, vuint8 size) {
     OdtEntryAddr(gXcp.WriteDaqOdtEntry) = addr; // Holds A2L/XCP address
     XcpAdjustOdtSize(gXcp.WriteDaqDaq, gXcp.WriteDaqOdt, size);
     gXcp.WriteDaqOdtEntry++; // Autoincrement to next ODT entry, no autoincrementing over ODTs
+    gXcp.CopyPlanValid = 0;
     return 0;
 }
 
 // Set DAQ list mode
-void  XcpSetDaqListMode(vuint16 daq, vuint16 event, vuint8 mode ) {
+void  XcpSetDaqListMode(vuint16 daq, vuint16 event, vuint8 mode, vuint8 prescaler ) {
+  if (DaqListEventChannel(daq) != event) gXcp.CopyPlanValid = 0; // Copy plans are grouped by event
   DaqListEventChannel(daq) = event;
   DaqListFlags(daq) = mode;
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+  DaqListPrescaler(daq) = prescaler;
+#else
+  (void)prescaler;
+#endif
+}
+
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+
+// Allocate the shadow copies of the ODTs of all DAQ lists in on change mode, starting at DAQ memory offset offset
+// DAQ lists without space for all shadow copies are transmitted on every event
+static void XcpAllocShadows( vuint32 offset )
+{
+  vuint32 n;
+  vuint16 daq, odt;
+
+  for (odt = 0; odt < gXcp.Daq.OdtCount; odt++) DaqListOdtShadow(odt) = 0;
+
+  // Size of all shadow copies
+  n = 0;
+  for (daq = 0; daq < gXcp.Daq.DaqCount; daq++) {
+    if (DaqListOnChange(daq) == XCP_DAQ_ON_CHANGE_OFF) continue;
+    for (odt = DaqListFirstOdt(daq); odt <= DaqListLastOdt(daq); odt++) n += ((vuint32)DaqListOdtSize(odt) + 7) & ~7u;
+  }
+  if (n == 0) return;
+
+#ifdef XCP_ENABLE_DYNAMIC_DAQ_MEM
+  if (offset + n > XcpDaqMemSize() && offset + n < XCP_DAQ_MEM_SIZE) XcpGrowDaqMemory(offset + n); // May fail, if DAQ is running
+#endif
+
+  for (daq = 0; daq < gXcp.Daq.DaqCount; daq++) {
+    if (DaqListOnChange(daq) == XCP_DAQ_ON_CHANGE_OFF) continue;
+    for (odt = DaqListFirstOdt(daq); odt <= DaqListLastOdt(daq); odt++) {
+      n = ((vuint32)DaqListOdtSize(odt) + 7) & ~7u;
+      if (offset + n > XcpDaqMemSize()) break; // Out of memory
+      DaqListOdtShadow(odt) = offset;
+      memset(&gXcp.Daq.u.b[offset], 0, n);
+      offset += n;
+    }
+    if (odt <= DaqListLastOdt(daq)) { // Incomplete, transmit on every event
+      for (odt = DaqListFirstOdt(daq); odt <= DaqListLastOdt(daq); odt++) DaqListOdtShadow(odt) = 0;
+    }
+  }
+}
+
+#endif
+
+#ifdef XCP_ENABLE_DAQ_GATHER
+
+// Replace runs of at least XCP_DAQ_GATHER_MIN scattered 4 byte copy operations in the copy plan operations first..last-1 by gather operations
+// The source addresses are stored in place behind the gather operation, so the copy plan never grows
+// Returns the new end of the copy plan
+static vuint32 XcpCompileGather( vuint32 first, vuint32 last )
+{
+  tXcpCopyOp* ops = gXcp.pCopyOp;
+  vuint32* idx;
+  vuint32 r, w, j, k, a0, a1;
+
+  for (r = w = first; r < last; ) {
+
+    // Length of the run of 4 byte copies at r, the AVX2 gather uses signed 32 bit offsets
+    for (k = 0; r + k < last && k < 0x3FFF && ops[r + k].size == 4 && ops[r + k].addr < 0x80000000UL; k++);
+    if (k < XCP_DAQ_GATHER_MIN) {
+      if (k == 0) k = 1;
+      while (k-- > 0) ops[w++] = ops[r++];
+      continue;
+    }
+
+    // Store the addresses pairwise, the write position never overtakes the read position
+    idx = (vuint32*)&ops[w + 1];
+    for (j = 0; j < k; j += 2) {
+      a0 = ops[r + j].addr;
+      a1 = (j + 1 < k) ? ops[r + j + 1].addr : 0;
+      idx[j] = a0;
+      idx[j + 1] = a1;
+    }
+    ops[w].addr = 0;
+    ops[w].size = (vuint16)(k * 4);
+    ops[w].type = XCP_COPY_OP_GATHER32;
+    w += 1 + (k + 1) / 2;
+    r += k;
+  }
+  return w;
+}
+
+#endif
+
+// Compile the ODT entries of all ODTs into copy plans
+// Adjacent source ranges are merged into a single copy operation
+// The copy plans are stored in the free DAQ memory behind the ODT entries, ODTs without space for their plan keep copyOpCount=0 and are copied entry by entry
+// The copy plans of all DAQ lists of an event are contiguous, so the event walks them with a constant stride
+static void XcpCompileCopyPlans( void )
+{
+  vuint32 used, maxOps, o;
+  vuint16 daq, odt, e, el, event;
+  vuint32 sc, n;
+  tXcpCopyOp* op;
+
+  // Free memory behind the ODT entries, cache line aligned
+  used = XcpDaqMemAlign((vuint32)((vuint8*)&gXcp.pOdtEntrySize[gXcp.Daq.OdtEntryCount] - &gXcp.Daq.u.b[0]));
+  gXcp.pCopyOp = (tXcpCopyOp*)&gXcp.Daq.u.b[used];
+  maxOps = used < XcpDaqMemSize() ? (XcpDaqMemSize() - used) / (vuint32)sizeof(tXcpCopyOp) : 0;
+  if (maxOps > 0xFFFF) maxOps = 0xFFFF;
+
+  for (odt = 0; odt < gXcp.Daq.OdtCount; odt++) DaqListOdtCopyOpCount(odt) = 0;
+
+  o = 0;
+  for (event = 0; event < XCP_MAX_EVENT; event++) {
+    for (daq = 0; daq < gXcp.Daq.DaqCount; daq++) {
+      if (DaqListEventChannel(daq) != event) continue;
+#ifdef XCP_ENABLE_PACKED_MODE
+      sc = DaqListSampleCount(daq);
+      if (sc < 1) sc = 1;
+#else
+      sc = 1;
+#endif
+      for (odt = DaqListFirstOdt(daq); odt <= DaqListLastOdt(daq); odt++) {
+        DaqListOdtFirstCopyOp(odt) = (vuint16)o;
+        op = NULL;
+        el = DaqListOdtLastEntry(odt);
+        for (e = DaqListOdtFirstEntry(odt); e <= el; e++) {
+          n = OdtEntrySize(e) * sc;
+          if (n == 0) break;
+          if (op != NULL && op->addr + op->size == OdtEntryAddr(e) && op->size + n <= 0xFFFF) { // Merge with previous range
+            op->size = (vuint16)(op->size + n);
+            continue;
+          }
+          if (o >= maxOps) break; // Out of memory
+          op = &gXcp.pCopyOp[o++];
+          op->addr = OdtEntryAddr(e);
+          op->size = (vuint16)n;
+          op->type = XCP_COPY_OP_COPY;
+        }
+        if (e <= el && OdtEntrySize(e) != 0) { // Plan incomplete, copy entry by entry
+          o = DaqListOdtFirstCopyOp(odt);
+          continue;
+        }
+#ifdef XCP_ENABLE_DAQ_GATHER
+        o = XcpCompileGather(DaqListOdtFirstCopyOp(odt), o);
+#endif
+        DaqListOdtCopyOpCount(odt) = (vuint16)(o - DaqListOdtFirstCopyOp(odt));
+      }
+    }
+  }
+
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+  XcpAllocShadows(XcpDaqMemAlign(used + o * (vuint32)sizeof(tXcpCopyOp)));
+#endif
+
+  gXcp.CopyPlanValid = 1;
+
+#ifdef XCP_ENABLE_TESTMODE
+  if (ApplXcpDebugLevel >= 3) ApplXcpPrint("[XcpCompileCopyPlans] %u ODT entries compiled into %u copy operations\n", gXcp.Daq.OdtEntryCount, o);
+#endif
+}
+
+// Reset the overflow counters and indications on DAQ start
+static void XcpResetOverflow( void )
+{
+  vuint16 i;
+
+  atomicStore32(&gXcp.DaqOverflowCount, 0);
+  for (i = 0; i < XCP_MAX_EVENT; i++) atomicStore32(&gXcp.EventOverflowCount[i], 0);
+  for (i = 0; i < gXcp.Daq.DaqCount; i++) atomicStore32(&DaqListOverrun(i), 0);
 }
 
 // Start DAQ
 void  XcpStartDaq( vuint16 daq )
 {
+  if (!gXcp.CopyPlanValid) XcpCompileCopyPlans();
   gXcp.DaqStartClock64 = ApplXcpGetClock64();
-  gXcp.DaqOverflowCount = 0;
+  XcpResetOverflow();
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+  atomicStore32(&DaqListPrescalerCount(daq), 0);
+#endif
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+  if (DaqListOnChange(daq) != XCP_DAQ_ON_CHANGE_OFF) atomicStore32(&DaqListOnChange(daq), XCP_DAQ_ON_CHANGE_PENDING);
+#endif
   DaqListFlags(daq) |= (vuint8)DAQ_FLAG_RUNNING;
+  XcpUpdateEventDaqLists();
 
   ApplXcpDaqStart();
   gXcp.SessionStatus |= (vuint8)SS_DAQ;
@@ -318,10 +741,17 @@ void  XcpStartAllSelectedDaq()
   vuint16 daq;
 
   /* Start all selected DAQs */
+  if (!gXcp.CopyPlanValid) XcpCompileCopyPlans();
   gXcp.DaqStartClock64 = ApplXcpGetClock64();
-  gXcp.DaqOverflowCount = 0;
+  XcpResetOverflow();
   for (daq=0;daq<gXcp.Daq.DaqCount;daq++)  {
     if ( (DaqListFlags(daq) & (vuint8)DAQ_FLAG_SELECTED) != 0 ) {
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+      atomicStore32(&DaqListPrescalerCount(daq), 0);
+#endif
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+      if (DaqListOnChange(daq) != XCP_DAQ_ON_CHANGE_OFF) atomicStore32(&DaqListOnChange(daq), XCP_DAQ_ON_CHANGE_PENDING);
+#endif
       DaqListFlags(daq) |= (vuint8)DAQ_FLAG_RUNNING;
       DaqListFlags(daq) &= (vuint8)(~DAQ_FLAG_SELECTED);
 #ifdef XCP_ENABLE_TESTMODE
@@ -331,6 +761,7 @@ void  XcpStartAllSelectedDaq()
 #endif
     }
   }
+  XcpUpdateEventDaqLists();
 
   ApplXcpDaqStart();
   gXcp.SessionStatus |= (vuint8)SS_DAQ;
@@ -339,9 +770,10 @@ void  XcpStartAllSelectedDaq()
 // Stop DAQ
 void  XcpStopDaq( vuint16 daq )
 {
-  vuint8 i;
+  vuint16 i;
 
   DaqListFlags(daq) &= (vuint8)(DAQ_FLAG_DIRECTION|DAQ_FLAG_TIMESTAMP|DAQ_FLAG_NO_PID);
+  XcpUpdateEventDaqLists();
 
   /* Check if all DAQ lists are stopped */
   for (i=0;i<gXcp.Daq.DaqCount;i++)  {
@@ -370,9 +802,10 @@ void  XcpStopAllSelectedDaq()
 // Stop all DAQs
 void  XcpStopAllDaq( void )
 {
-  for (vuint8 daq=0; daq<gXcp.Daq.DaqCount; daq++) {
+  for (vuint16 daq=0; daq<gXcp.Daq.DaqCount; daq++) {
     DaqListFlags(daq) &= (vuint8)(DAQ_FLAG_DIRECTION|DAQ_FLAG_TIMESTAMP|DAQ_FLAG_NO_PID);
   }
+  XcpUpdateEventDaqLists();
 
   ApplXcpDaqStop();
   gXcp.SessionStatus &= (vuint8)(~SS_DAQ);
@@ -383,95 +816,549 @@ void  XcpStopAllDaq( void )
 /* Data Aquisition Processor                                                */
 /****************************************************************************/
 
-// Measurement data acquisition, sample and transmit measurement date associated to event
+#ifdef XCP_ENABLE_AVX2
 
-static void XcpEvent_(vuint16 event, vuint8* base, vuint64 clock)
+// Check, if the CPU and the operating system support AVX2
+static vuint8 XcpCpuHasAvx2( void )
 {
-  vuint8* d;
-  vuint8* d0;
-  void* p0;
-  vuint32 e, el, odt, daq, hs, n;
-#ifdef XCP_ENABLE_PACKED_MODE
-  vuint32 sc;
+#if defined ( _MSC_VER )
+  int info[4];
+  __cpuid(info, 1);
+  if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) return 0; // OSXSAVE and AVX
+  if ((_xgetbv(0) & 6) != 6) return 0; // XMM and YMM state saved by the operating system
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0 ? 1 : 0; // AVX2
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? 1 : 0;
 #endif
-  
-  for (daq=0; daq<gXcp.Daq.DaqCount; daq++) {
+}
+
+#endif
+
+#ifdef XCP_ENABLE_DAQ_GATHER
+
+#ifdef XCP_ENABLE_AVX2
+
+// Gather n 4 byte values from base+idx[i] to d, 8 values per AVX2 gather instruction
+#ifndef _MSC_VER
+__attribute__((target("avx2")))
+#endif
+static void XcpGather32Avx2(vuint8* d, const vuint8* base, const vuint32* idx, vuint32 n)
+{
+  vuint32 i;
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m256i vi = _mm256_loadu_si256((const __m256i*)&idx[i]);
+    __m256i v = _mm256_i32gather_epi32((const int*)base, vi, 1);
+    _mm256_storeu_si256((__m256i*)&d[i * 4], v);
+  }
+  for (; i < n; i++) memcpy(&d[i * 4], &base[idx[i]], 4);
+}
+
+#endif
+
+// Gather n 4 byte values from base+idx[i] to d
+static void XcpGather32(vuint8* d, const vuint8* base, const vuint32* idx, vuint32 n)
+{
+  vuint32 i;
+#ifdef XCP_ENABLE_AVX2
+  if (gXcp.CpuAvx2) {
+    XcpGather32Avx2(d, base, idx, n);
+    return;
+  }
+#endif
+  for (i = 0; i < n; i++) memcpy(&d[i * 4], &base[idx[i]], 4); // Scalar fallback
+}
 
-      if ((DaqListFlags(daq) & (vuint8)DAQ_FLAG_RUNNING) == 0) continue; // DAQ list not active
-      if ( DaqListEventChannel(daq) != event ) continue; // DAQ list not associated with this event
+#endif
+
+// Sample one ODT into the DTO buffer d0, hs is the DTO header size (with or without timestamp)
+static void XcpSampleOdt(vuint8* d0, vuint16 daq, vuint16 odt, vuint32 hs, const vuint8* base, vuint64 clock)
+{
+  vuint8* d;
+  vuint32 e, el, n;
 #ifdef XCP_ENABLE_PACKED_MODE
-      sc = DaqListSampleCount(daq); // Packed mode sample count, 0 if not packed
+  vuint32 sc = DaqListSampleCount(daq); // Packed mode sample count, 0 if not packed
 #endif
-      for (hs=2+XCP_TIMESTAMP_SIZE,odt=DaqListFirstOdt(daq);odt<=DaqListLastOdt(daq);hs=2,odt++)  { 
-                      
-        // Get DTO buffer, overrun if not available
-        if ((d0 = ApplXcpGetDtoBuffer(&p0, DaqListOdtSize(odt)+hs)) == 0) {
-#ifdef XCP_ENABLE_TESTMODE
-            if (ApplXcpDebugLevel >= 2) ApplXcpPrint("DAQ queue overflow! Event %u skipped\n", event);
+
+  /* ODT,DAQ header */
+  d0[0] = (vuint8)(odt-DaqListFirstOdt(daq)); /* Relative odt number */
+#ifdef XCP_ENABLE_DAQ_HDR_ODT_FIL_DAQW
+  d0[1] = 0;
+  *((vuint16*)&d0[2]) = daq;
+#else
+  d0[1] = (vuint8)daq;
 #endif
-            gXcp.DaqOverflowCount++;
-            DaqListFlags(daq) |= DAQ_FLAG_OVERRUN;
-            return; // Skip rest of this event on queue overrun
-        }
-  
-        /* ODT,DAQ header */
-        d0[0] = (vuint8)(odt-DaqListFirstOdt(daq)); /* Relative odt number */
-        d0[1] = (vuint8)daq;
-        
-        /* Use BIT7 of PID or ODT to indicate overruns */  
-        if ( (DaqListFlags(daq) & DAQ_FLAG_OVERRUN) != 0 ) {
-          d0[0] |= 0x80;
-          DaqListFlags(daq) &= (vuint8)(~DAQ_FLAG_OVERRUN);
-        }
-  
-        /* Timestamp */
+
+  /* Use BIT7 of PID or ODT to indicate overruns */  
+  if (atomicLoad32(&DaqListOverrun(daq)) != 0 && atomicExchange32(&DaqListOverrun(daq), 0) != 0) { // Exactly one ODT gets the indication
+    d0[0] |= 0x80;
+  }
+
+  /* Timestamp */
 #if (XCP_TIMESTAMP_SIZE==8) // @@@@ XCP V1.6
-        if (hs==10) *((vuint64*)&d0[2]) = clock;
+  if (hs==XCP_DAQ_HDR_SIZE+8) *((vuint64*)&d0[XCP_DAQ_HDR_SIZE]) = clock;
 #else
-        if (hs==6) *((vuint32*)&d0[2]) = (vuint32)clock;
-#endif
-
-        /* Copy data */
-        /* This is the inner loop, optimize here */
-        e = DaqListOdtFirstEntry(odt);
-        if (OdtEntrySize(e) != 0) {
-            el = DaqListOdtLastEntry(odt);
-            d = &d0[hs];
-            while (e <= el) { // inner DAQ loop
-                n = OdtEntrySize(e);
-                if (n == 0) break;
+  if (hs==XCP_DAQ_HDR_SIZE+4) *((vuint32*)&d0[XCP_DAQ_HDR_SIZE]) = (vuint32)clock;
+#endif
+
+  /* Copy data */
+  /* This is the inner loop, optimize here */
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+  if (DaqListOdtShadow(odt) != 0 && DaqListOnChange(daq) != XCP_DAQ_ON_CHANGE_OFF) { // Transmit the data compared in XcpOdtChanged
+      memcpy(&d0[hs], &gXcp.Daq.u.b[DaqListOdtShadow(odt)], DaqListOdtSize(odt));
+  }
+  else
+#endif
+  if (DaqListOdtCopyOpCount(odt) != 0) { // Execute the copy plan
+      const tXcpCopyOp* op = &gXcp.pCopyOp[DaqListOdtFirstCopyOp(odt)];
+      const tXcpCopyOp* opl = op + DaqListOdtCopyOpCount(odt);
+      d = &d0[hs];
+      for (; op < opl; op++) {
+          const vuint8* s = &base[op->addr];
+#ifdef XCP_ENABLE_DAQ_GATHER
+          if (op->type == XCP_COPY_OP_GATHER32) {
+              XcpGather32(d, base, (const vuint32*)(op + 1), op->size / 4u);
+              d += op->size;
+              op += (op->size / 4u + 1) / 2; // Skip the source addresses
+              continue;
+          }
+#endif
+          switch (op->size) { // Fixed size copies compile to single loads and stores
+          case 1: *d = *s; break;
+          case 2: memcpy((vuint8*)d, s, 2); break;
+          case 4: memcpy((vuint8*)d, s, 4); break;
+          case 8: memcpy((vuint8*)d, s, 8); break;
+          default: memcpy((vuint8*)d, s, op->size); break;
+          }
+          d += op->size;
+      }
+  }
+  else if (OdtEntrySize(e = DaqListOdtFirstEntry(odt)) != 0) { // Copy entry by entry
+      el = DaqListOdtLastEntry(odt);
+      d = &d0[hs];
+      while (e <= el) { // inner DAQ loop
+          n = OdtEntrySize(e);
+          if (n == 0) break;
 #ifdef XCP_ENABLE_PACKED_MODE
-                if (sc>1) n *= sc; // packed mode
+          if (sc>1) n *= sc; // packed mode
 #endif
-                memcpy((vuint8*)d, &base[OdtEntryAddr(e)], n);
-                d += n;
-                e++;
-            } // ODT entry
-        }
+          memcpy((vuint8*)d, &base[OdtEntryAddr(e)], n);
+          d += n;
+          e++;
+      } // ODT entry
+  }
+}
+
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+
+// Compare the data of an ODT with its shadow copy and update the shadow copy
+// Returns 1, if the data changed or the ODT has no shadow copy
+// memcmp and memcpy of the merged copy plan ranges are vectorized by the C library
+static int XcpOdtChanged(vuint16 daq, vuint16 odt, const vuint8* base)
+{
+  vuint8* s;
+  vuint32 e, el, n;
+  int changed = 0;
+
+  if (DaqListOdtShadow(odt) == 0) return 1;
+  s = &gXcp.Daq.u.b[DaqListOdtShadow(odt)];
+  if (DaqListOdtCopyOpCount(odt) != 0) {
+      const tXcpCopyOp* op = &gXcp.pCopyOp[DaqListOdtFirstCopyOp(odt)];
+      const tXcpCopyOp* opl = op + DaqListOdtCopyOpCount(odt);
+      for (; op < opl; op++) {
+#ifdef XCP_ENABLE_DAQ_GATHER
+          if (op->type == XCP_COPY_OP_GATHER32) {
+              const vuint32* idx = (const vuint32*)(op + 1);
+              for (n = 0; n < op->size / 4u; n++, s += 4) {
+                  if (memcmp(s, &base[idx[n]], 4) != 0) {
+                      memcpy(s, &base[idx[n]], 4);
+                      changed = 1;
+                  }
+              }
+              op += (op->size / 4u + 1) / 2; // Skip the source addresses
+              continue;
+          }
+#endif
+          if (memcmp(s, &base[op->addr], op->size) != 0) {
+              memcpy(s, &base[op->addr], op->size);
+              changed = 1;
+          }
+          s += op->size;
+      }
+  }
+  else {
+#ifdef XCP_ENABLE_PACKED_MODE
+      vuint32 sc = DaqListSampleCount(daq);
+#endif
+      el = DaqListOdtLastEntry(odt);
+      for (e = DaqListOdtFirstEntry(odt); e <= el; e++) {
+          n = OdtEntrySize(e);
+          if (n == 0) break;
+#ifdef XCP_ENABLE_PACKED_MODE
+          if (sc>1) n *= sc; // packed mode
+#endif
+          if (memcmp(s, &base[OdtEntryAddr(e)], n) != 0) {
+              memcpy(s, &base[OdtEntryAddr(e)], n);
+              changed = 1;
+          }
+          s += n;
+      }
+  }
+  return changed;
+}
 
-        ApplXcpCommitDtoBuffer(p0);
-               
+// Compare all ODTs of a DAQ list in on change mode, returns 1 if the DAQ list has to be transmitted
+static int XcpDaqListChanged(vuint16 daq, const vuint8* base)
+{
+  vuint16 odt;
+  int changed = 0;
+
+  // The first event after DAQ start or after an overflow is always transmitted
+  if (atomicLoad32(&DaqListOnChange(daq)) == XCP_DAQ_ON_CHANGE_PENDING && atomicExchange32(&DaqListOnChange(daq), XCP_DAQ_ON_CHANGE_ON) == XCP_DAQ_ON_CHANGE_PENDING) changed = 1;
+  for (odt = DaqListFirstOdt(daq); odt <= DaqListLastOdt(daq); odt++) { // All shadow copies have to be updated
+      if (XcpOdtChanged(daq, odt, base)) changed = 1;
+  }
+  return changed;
+}
+
+// Transmit all DAQ lists in on change mode of an event on the next event
+static void XcpDaqListChangedReset(vuint16 event)
+{
+  vuint16 daq;
+  for (daq=gXcp.EventDaqFirst[event]; daq!=XCP_UNDEFINED_DAQ_LIST; daq=DaqListNext(daq)) {
+      if (atomicLoad32(&DaqListOnChange(daq)) != XCP_DAQ_ON_CHANGE_OFF) atomicStore32(&DaqListOnChange(daq), XCP_DAQ_ON_CHANGE_PENDING);
+  }
+}
+
+#endif
+
+// Transmit count sampled ODTs of an event
+// With ApplXcpGetDtoBuffers, all ODTs are reserved and committed with a single transport layer operation and are transmitted consistently in one packet
+// Falls back to one DTO buffer reservation per ODT, if they do not fit at once
+// Returns 0 on DTO buffer overflow, the rest of the event is skipped
+static int XcpEventFlush_(vuint16 event, vuint32 count, const vuint16* daqs, const vuint16* odts, const vuint16* sizes, const vuint8* base, vuint64 clock)
+{
+  vuint8* d0;
+  void* p0;
+  vuint32 i;
+
+#if defined ( ApplXcpGetDtoBuffers ) && defined ( ApplXcpCommitDtoBuffers )
+  if (count > 1) {
+      vuint8* dtos[XCP_MAX_EVENT_ODT];
+      vuint32 size = 0;
+      for (i = 0; i < count; i++) size += sizes[i];
+      if (ApplXcpGetDtoBuffers(&p0, count, sizes, dtos)) {
+          for (i = 0; i < count; i++) XcpSampleOdt(dtos[i], daqs[i], odts[i], sizes[i] - DaqListOdtSize(odts[i]), base, clock);
+          ApplXcpCommitDtoBuffers(p0, count, size);
+          return 1;
+      }
+  }
+#endif
+
+  for (i = 0; i < count; i++) {
+
+      // Get DTO buffer, overrun if not available
+      if ((d0 = ApplXcpGetDtoBuffer(&p0, sizes[i])) == 0) {
+#ifdef XCP_ENABLE_TESTMODE
+          if (ApplXcpDebugLevel >= 2) ApplXcpPrint("DAQ queue overflow! Event %u skipped\n", event);
+#endif
+          atomicAdd32(&gXcp.DaqOverflowCount, 1);
+          atomicAdd32(&gXcp.EventOverflowCount[event], 1);
+          atomicStore32(&DaqListOverrun(daqs[i]), 1);
+          return 0;
+      }
+
+      XcpSampleOdt(d0, daqs[i], odts[i], sizes[i] - DaqListOdtSize(odts[i]), base, clock);
+
+      ApplXcpCommitDtoBuffer(p0);
+  }
+  return 1;
+}
+
+// Measurement data acquisition, sample and transmit measurement date associated to event
+// Thread safe, may run in parallel for the same or different events
+// DAQ list configuration is read only here, overrun indication, prescaler and overflow counters are updated atomically
+// The ODTs of the event are collected and transmitted in batches of up to XCP_MAX_EVENT_ODT
+static void XcpEvent_(vuint16 event, vuint8* base, vuint64 clock)
+{
+  vuint16 sizes[XCP_MAX_EVENT_ODT];
+  vuint16 odts[XCP_MAX_EVENT_ODT];
+  vuint16 daqs[XCP_MAX_EVENT_ODT];
+  vuint32 count, hs;
+  vuint16 daq, odt;
+
+  count = 0;
+  for (daq=gXcp.EventDaqFirst[event]; daq!=XCP_UNDEFINED_DAQ_LIST; daq=DaqListNext(daq)) { // Running DAQ lists associated with this event
+
+      if ((DaqListFlags(daq) & (vuint8)DAQ_FLAG_RUNNING) == 0) continue; // DAQ list stopped meanwhile
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+      // Decimation, decided before any DTO buffer is reserved, the first event after start is sampled
+      if (DaqListPrescaler(daq) > 1 && (atomicAdd32(&DaqListPrescalerCount(daq), 1) - 1) % DaqListPrescaler(daq) != 0) continue;
+#endif
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+      // Skip the DAQ list, if the data of none of its ODTs changed
+      // Parallel events of the same DAQ list in on change mode may transmit redundant data
+      if (DaqListOnChange(daq) != XCP_DAQ_ON_CHANGE_OFF && !XcpDaqListChanged(daq, base)) continue;
+#endif
+      for (hs=XCP_DAQ_HDR_SIZE+XCP_TIMESTAMP_SIZE,odt=DaqListFirstOdt(daq);odt<=DaqListLastOdt(daq);hs=XCP_DAQ_HDR_SIZE,odt++)  { 
+          if (count >= XCP_MAX_EVENT_ODT) {
+              if (!XcpEventFlush_(event, count, daqs, odts, sizes, base, clock)) goto overflow; // Skip rest of this event on queue overrun
+              count = 0;
+          }
+          sizes[count] = (vuint16)(DaqListOdtSize(odt)+hs);
+          odts[count] = odt;
+          daqs[count] = daq;
+          count++;
       } /* odt */
 
   } /* daq */
-  
+
+  if (count > 0 && !XcpEventFlush_(event, count, daqs, odts, sizes, base, clock)) goto overflow;
+  return;
+
+overflow:
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+  XcpDaqListChangedReset(event); // The shadow copies may contain data which has not been transmitted
+#endif
+  return;
 }
 
 void XcpEventAt(vuint16 event, vuint64 clock) {
     if ((gXcp.SessionStatus & (vuint8)SS_DAQ) == 0) return; // DAQ not running
+    if (!isEventActive(event)) return; // No DAQ list running on this event
     XcpEvent_(event, ApplXcpGetBaseAddr(), clock);
 }
 
 void XcpEventExt(vuint16 event, vuint8* base) {
     if ((gXcp.SessionStatus & (vuint8)SS_DAQ) == 0) return; // DAQ not running
+    if (!isEventActive(event)) return; // No DAQ list running on this event
     XcpEvent_(event, base, ApplXcpGetClock64());
 }
 
 void XcpEvent(vuint16 event) {
     if ((gXcp.SessionStatus & (vuint8)SS_DAQ) == 0) return; // DAQ not running
+    if (!isEventActive(event)) return; // No DAQ list running on this event
     XcpEvent_(event, ApplXcpGetBaseAddr(), ApplXcpGetClock64());
 }
 
+#ifdef XCP_ENABLE_BENCHMARK
+
+// Sample all ODTs of the running DAQ lists of event into the buffer d, like XcpEvent_ without the transport layer DTO buffer reservation
+static void XcpBenchmarkSample(vuint8* d, vuint16 event, const vuint8* base)
+{
+  vuint16 daq, odt;
+  vuint32 hs;
+
+  for (daq=gXcp.EventDaqFirst[event]; daq!=XCP_UNDEFINED_DAQ_LIST; daq=DaqListNext(daq)) {
+    for (hs=XCP_DAQ_HDR_SIZE+XCP_TIMESTAMP_SIZE,odt=DaqListFirstOdt(daq);odt<=DaqListLastOdt(daq);hs=XCP_DAQ_HDR_SIZE,odt++) {
+        XcpSampleOdt(d, daq, odt, hs, base, 0);
+        d += DaqListOdtSize(odt) + hs;
+    }
+  }
+}
+
+// Time loops samplings of event 0, returns the time per event in ns
+static double XcpBenchmarkRun(vuint8* d, vuint32 loops)
+{
+  const vuint8* base = ApplXcpGetBaseAddr();
+  vuint64 t;
+  vuint32 i;
+
+  XcpBenchmarkSample(d, 0, base); // Warm up
+  t = ApplXcpGetClock64();
+  for (i = 0; i < loops; i++) XcpBenchmarkSample(d, 0, base);
+  return (double)(ApplXcpGetClock64() - t) * 1000.0 / CLOCK_TICKS_PER_US / loops;
+}
+
+// Measure the sampling time of an event for count ODT entries addr[]/size[]
+// The entries are split evenly into daqCount DAQ lists, which alternate between event 0 and event 1, only event 0 is sampled
+// Each DAQ list is split into ODTs of maximum DTO size, as a XCP master would do
+// Compares the entry by entry copy, the copy plan with scalar copies and the copy plan with AVX2 gather, if supported by the CPU
+// Overwrites the DAQ configuration, must not be called while a XCP master is connected
+// Returns 0 on error
+int XcpDaqBenchmark(const char* name, vuint32 count, const vuint32* addr, const vuint8* size, vuint16 daqCount, vuint32 loops)
+{
+  vuint32* first; // First entry of each ODT, first[odtFirst[daq]] is the first entry of DAQ list daq
+  vuint32* odtFirst; // First ODT of each DAQ list
+  vuint16* ops;
+  vuint32 odtCount, sampled, i, n, s, bufferSize;
+  vuint16 daq, odt;
+  vuint8* buffer[3];
+  double t[3];
+  vuint8 err = 0;
+#ifdef XCP_ENABLE_AVX2
+  vuint8 avx2 = gXcp.CpuAvx2;
+#endif
+
+  if (daqCount == 0 || daqCount > count) return 0;
+  first = (vuint32*)malloc((count + 1 + daqCount + 1) * sizeof(vuint32));
+  if (first == NULL) return 0;
+  odtFirst = first + count + 1;
+
+  // Split the entries into DAQ lists and the DAQ lists into ODTs
+  odtCount = 0;
+  for (daq = 0; daq < daqCount; daq++) {
+    odtFirst[daq] = odtCount;
+    for (i = (vuint32)((vuint64)count * daq / daqCount), s = 0; i < (vuint32)((vuint64)count * (daq + 1) / daqCount); i++) {
+      if (odtCount == odtFirst[daq] || s + size[i] > XCPTL_DTO_SIZE - XCP_DAQ_HDR_SIZE - XCP_TIMESTAMP_SIZE || i - first[odtCount - 1] >= 255) {
+        if (odtCount - odtFirst[daq] >= 255) err = CRC_OUT_OF_RANGE;
+        first[odtCount++] = i;
+        s = 0;
+      }
+      s += size[i];
+    }
+  }
+  odtFirst[daqCount] = odtCount;
+  first[odtCount] = count;
+
+  // Setup the DAQ lists, even DAQ lists on event 0, odd DAQ lists on event 1
+  XcpFreeDaq();
+  if (!err) err = XcpAllocDaq(daqCount);
+  for (daq = 0; !err && daq < daqCount; daq++) err = XcpAllocOdt(daq, (vuint8)(odtFirst[daq + 1] - odtFirst[daq]));
+  for (daq = 0; !err && daq < daqCount; daq++) {
+    for (odt = 0; !err && odt < odtFirst[daq + 1] - odtFirst[daq]; odt++) {
+      i = odtFirst[daq] + odt;
+      err = XcpAllocOdtEntry(daq, (vuint8)odt, (vuint8)(first[i + 1] - first[i]));
+    }
+  }
+  for (daq = 0; !err && daq < daqCount; daq++) {
+    for (odt = 0; !err && odt < odtFirst[daq + 1] - odtFirst[daq]; odt++) {
+      err = XcpSetDaqPtr(daq, (vuint8)odt, 0);
+      for (i = first[odtFirst[daq] + odt]; !err && i < first[odtFirst[daq] + odt + 1]; i++) err = XcpAddOdtEntry(addr[i], 0, size[i]);
+    }
+  }
+  free(first);
+  if (err) {
+    ApplXcpPrint("ERROR: DAQ setup failed (err=%02Xh)!\n", err);
+    XcpFreeDaq();
+    return 0;
+  }
+  for (daq = 0; daq < daqCount; daq++) {
+    XcpSetDaqListMode(daq, daq % 2, DAQ_FLAG_TIMESTAMP, 1);
+    DaqListFlags(daq) |= (vuint8)DAQ_FLAG_RUNNING; // Running state only, the transport layer is not involved
+  }
+  XcpCompileCopyPlans();
+  XcpUpdateEventDaqLists();
+
+  ops = (vuint16*)malloc(gXcp.Daq.OdtCount * sizeof(vuint16));
+  if (ops == NULL) {
+    XcpFreeDaq();
+    return 0;
+  }
+  bufferSize = 0;
+  sampled = 0;
+  n = 0;
+  for (daq = gXcp.EventDaqFirst[0]; daq != XCP_UNDEFINED_DAQ_LIST; daq = DaqListNext(daq)) {
+    for (odt = DaqListFirstOdt(daq); odt <= DaqListLastOdt(daq); odt++) {
+      bufferSize += DaqListOdtSize(odt) + XCP_DAQ_HDR_SIZE + (odt == DaqListFirstOdt(daq) ? XCP_TIMESTAMP_SIZE : 0);
+      sampled += DaqListOdtLastEntry(odt) - DaqListOdtFirstEntry(odt) + 1;
+      ops[odt] = DaqListOdtCopyOpCount(odt);
+      n += ops[odt];
+    }
+  }
+  buffer[0] = (vuint8*)calloc(3, bufferSize);
+  if (buffer[0] == NULL) {
+    free(ops);
+    XcpFreeDaq();
+    return 0;
+  }
+  buffer[1] = buffer[0] + bufferSize;
+  buffer[2] = buffer[1] + bufferSize;
+
+  // Entry by entry copy
+  for (daq = gXcp.EventDaqFirst[0]; daq != XCP_UNDEFINED_DAQ_LIST; daq = DaqListNext(daq)) {
+    for (odt = DaqListFirstOdt(daq); odt <= DaqListLastOdt(daq); odt++) DaqListOdtCopyOpCount(odt) = 0;
+  }
+  t[0] = XcpBenchmarkRun(buffer[0], loops);
+  for (daq = gXcp.EventDaqFirst[0]; daq != XCP_UNDEFINED_DAQ_LIST; daq = DaqListNext(daq)) {
+    for (odt = DaqListFirstOdt(daq); odt <= DaqListLastOdt(daq); odt++) DaqListOdtCopyOpCount(odt) = ops[odt];
+  }
+
+  // Copy plan, scalar
+#ifdef XCP_ENABLE_AVX2
+  gXcp.CpuAvx2 = 0;
+#endif
+  t[1] = XcpBenchmarkRun(buffer[1], loops);
+  t[2] = 0;
+
+  // Copy plan, AVX2 gather
+#ifdef XCP_ENABLE_AVX2
+  gXcp.CpuAvx2 = avx2;
+  if (avx2) t[2] = XcpBenchmarkRun(buffer[2], loops);
+#endif
+
+  ApplXcpPrint("%s: %u entries in %u DAQ lists, %u entries on event 0, %u bytes, %u ODTs, %u copy operations\n", name, count, daqCount, sampled, bufferSize, odtCount, n);
+  ApplXcpPrint("  entry by entry  %8.1fns/event %6.2fns/entry\n", t[0], t[0] / sampled);
+  ApplXcpPrint("  copy plan scalar%8.1fns/event %6.2fns/entry\n", t[1], t[1] / sampled);
+  if (t[2] > 0) ApplXcpPrint("  copy plan AVX2  %8.1fns/event %6.2fns/entry\n", t[2], t[2] / sampled);
+  if (memcmp(buffer[0], buffer[1], bufferSize) != 0 || (t[2] > 0 && memcmp(buffer[0], buffer[2], bufferSize) != 0)) {
+    ApplXcpPrint("ERROR: sampled data differs!\n");
+    err = CRC_DAQ_CONFIG;
+  }
+
+  free(buffer[0]);
+  free(ops);
+  XcpFreeDaq();
+  return err == 0;
+}
+
+#ifdef XCP_ENABLE_CHECKSUM
+
+// Measure the BUILD_CHECKSUM throughput of all checksum types over size bytes with the scalar and, if supported by the CPU, the AVX2 kernels
+// Returns 0 on error
+int XcpChecksumBenchmark(vuint32 size, vuint32 loops)
+{
+  static const struct { vuint8 type; const char* name; } types[4] = {
+    { XCP_CHECKSUM_TYPE_ADD44, "ADD_44" }, { XCP_CHECKSUM_TYPE_ADD14, "ADD_14" }, { XCP_CHECKSUM_TYPE_CRC16CCITT, "CRC_16_CITT" }, { XCP_CHECKSUM_TYPE_CRC32, "CRC_32" }
+  };
+  vuint8* p;
+  vuint32 i, j, l, r[2];
+  vuint64 t;
+  int ok = 1;
+#ifdef XCP_ENABLE_AVX2
+  vuint8 avx2 = gXcp.CpuAvx2;
+#endif
+
+  size &= ~3u; // ADD_44 block size must be a multiple of 4
+  if (size == 0 || (p = (vuint8*)malloc(size)) == NULL) return 0;
+  for (i = 0; i < size; i++) p[i] = (vuint8)(i * 7 + (i >> 8));
+
+  ApplXcpPrint("BUILD_CHECKSUM benchmark, %u bytes, %u checksums per measurement\n", size, loops);
+  for (j = 0; j < 4; j++) {
+    for (r[0] = r[1] = 0, i = 0; i < 2; i++) {
+#ifdef XCP_ENABLE_AVX2
+      if (i == 1 && (!avx2 || (types[j].type != XCP_CHECKSUM_TYPE_ADD44 && types[j].type != XCP_CHECKSUM_TYPE_ADD14))) break;
+      gXcp.CpuAvx2 = (vuint8)i;
+#else
+      if (i == 1) break;
+#endif
+      XcpChecksum(types[j].type, p, size); // Warm up
+      t = ApplXcpGetClock64();
+      for (l = 0; l < loops; l++) {
+        p[0] = (vuint8)l; // Not loop invariant
+        r[i] = XcpChecksum(types[j].type, p, size);
+      }
+      t = ApplXcpGetClock64() - t;
+      ApplXcpPrint("  %-12s %-7s %6.2f GByte/s (checksum=%08Xh)\n", types[j].name, i ? "AVX2" : "scalar", (double)size * loops * CLOCK_TICKS_PER_US / 1000.0 / (double)(t > 0 ? t : 1), r[i]);
+      if (i == 1 && r[1] != r[0]) {
+        ApplXcpPrint("ERROR: %s AVX2 checksum differs!\n", types[j].name);
+        ok = 0;
+      }
+    }
+  }
+
+#ifdef XCP_ENABLE_AVX2
+  gXcp.CpuAvx2 = avx2;
+#endif
+  free(p);
+  return ok;
+}
+
+#endif // XCP_ENABLE_CHECKSUM
+
+#endif
+
 /****************************************************************************/
 /* Command Processor                                                        */
 /****************************************************************************/
@@ -485,8 +1372,8 @@ void  XcpDisconnect( void )
 }
 
 
-//  Handles incoming XCP commands
-void  XcpCommand( const vuint32* pCommand )
+//  Executes an XCP command and transmits the response
+static void  XcpExecuteCommand( const vuint32* pCommand )
 {
   const tXcpCto* pCmd = (const tXcpCto*) pCommand; 
   vuint8 err = 0;
@@ -505,12 +1392,27 @@ void  XcpCommand( const vuint32* pCommand )
       }
 #endif
       
+#ifdef ApplXcpConnect
+    // The application may refuse the connection, the session status is set to connected before, to synchronize with the application
+    vuint8 status = gXcp.SessionStatus;
+    gXcp.SessionStatus = (vuint8)(status | SS_CONNECTED);
+    if (!ApplXcpConnect()) {
+        gXcp.SessionStatus = status; // DAQ owned by the application keeps running
+        error(CRC_RESOURCE_TEMPORARY_NOT_ACCESSIBLE);
+    }
+#endif
+
     // Set Session Status
     gXcp.SessionStatus = (vuint8)(SS_CONNECTED | SS_LEGACY_MODE);
 
     /* Reset DAQ */
     XcpFreeDaq();
 
+#ifdef XCP_ENABLE_CAL_PAGE
+    /* Complete a calibration transaction of a previous session */
+    ApplXcpCalSegCommit();
+#endif
+
     // Response
     gXcp.CrmLen = CRM_CONNECT_LEN;
     CRM_CONNECT_TRANSPORT_VERSION = (vuint8)( (vuint16)XCP_TRANSPORT_LAYER_VERSION >> 8 ); /* Major versions of the XCP Protocol Layer and Transport Layer Specifications. */
@@ -521,6 +1423,9 @@ void  XcpCommand( const vuint32* pCommand )
     CRM_CONNECT_RESOURCE |= (vuint8)RM_DAQ;       /* Data Acquisition */
     CRM_CONNECT_COMM_BASIC = 0;
     CRM_CONNECT_COMM_BASIC |= (vuint8)CMB_OPTIONAL;
+#ifdef XCP_ENABLE_BLOCK_MODE
+    CRM_CONNECT_COMM_BASIC |= (vuint8)CMB_SLAVE_BLOCK_MODE;
+#endif
 #if defined ( XCP_CPUTYPE_BIGENDIAN )
     CRM_CONNECT_COMM_BASIC |= (vuint8)PI_MOTOROLA;
 #endif
@@ -540,6 +1445,10 @@ void  XcpCommand( const vuint32* pCommand )
           return;
       }
 
+#ifdef XCP_ENABLE_BLOCK_MODE
+      if (gXcp.DownloadRemaining != 0 && CRO_CMD != CC_DOWNLOAD_NEXT) gXcp.DownloadRemaining = 0; // Any other command aborts a master block
+#endif
+
       switch (CRO_CMD)
       {
 
@@ -563,8 +1472,14 @@ void  XcpCommand( const vuint32* pCommand )
             CRM_GET_COMM_MODE_INFO_COMM_OPTIONAL = 0;
             CRM_GET_COMM_MODE_INFO_QUEUE_SIZE = 0;
 #endif
+#ifdef XCP_ENABLE_BLOCK_MODE
+            CRM_GET_COMM_MODE_INFO_COMM_OPTIONAL |= CMO_MASTER_BLOCK_MODE;
+            CRM_GET_COMM_MODE_INFO_MAX_BS = XCP_MAX_BS;
+            CRM_GET_COMM_MODE_INFO_MIN_ST = XCP_MIN_ST;
+#else
             CRM_GET_COMM_MODE_INFO_MAX_BS = 0;
             CRM_GET_COMM_MODE_INFO_MIN_ST = 0;
+#endif
           }
           break;
 
@@ -609,11 +1524,23 @@ void  XcpCommand( const vuint32* pCommand )
             {
               gXcp.CrmLen = CRM_GET_STATUS_LEN;
               CRM_GET_STATUS_STATUS = (vuint8)gXcp.SessionStatus;
+#ifdef XCP_ENABLE_CAL_STORE
+              if (ApplXcpCalStorePending()) CRM_GET_STATUS_STATUS |= (vuint8)SS_STORE_CAL_REQ;
+#endif
               CRM_GET_STATUS_PROTECTION = 0;
               CRM_GET_STATUS_CONFIG_ID = 0; /* Session configuration ID not available. */
             }
             break;
 
+#ifdef XCP_ENABLE_CAL_STORE
+          case CC_SET_REQUEST:
+            {
+              if (CRO_SET_REQUEST_MODE != SS_STORE_CAL_REQ) error(CRC_OUT_OF_RANGE) // Only STORE_CAL_REQ, the mode bits are the session status bits
+              check_error(ApplXcpCalStoreRequest());
+            }
+            break;
+#endif
+
           case CC_SET_MTA:
             {
               gXcp.Mta = ApplXcpGetPointer(CRO_SET_MTA_EXT,CRO_SET_MTA_ADDR);
@@ -624,12 +1551,53 @@ void  XcpCommand( const vuint32* pCommand )
           {
               vuint8 size;
               size = CRO_DOWNLOAD_SIZE;
+#ifdef XCP_ENABLE_BLOCK_MODE
+              if (size > CRO_DOWNLOAD_MAX_SIZE) { // Master block mode, the rest of the block follows with DOWNLOAD_NEXT, no response
+                  err = XcpWriteMta(CRO_DOWNLOAD_MAX_SIZE, CRO_DOWNLOAD_DATA);
+                  if (err == XCP_CMD_DENIED) error(CRC_WRITE_PROTECTED);
+                  gXcp.DownloadRemaining = (vuint8)(size - CRO_DOWNLOAD_MAX_SIZE);
+                  return;
+              }
+#else
               if (size > CRO_DOWNLOAD_MAX_SIZE) error(CRC_OUT_OF_RANGE)
+#endif
               err = XcpWriteMta(size, CRO_DOWNLOAD_DATA);
               if (err == XCP_CMD_DENIED) error(CRC_WRITE_PROTECTED);
+#ifdef XCP_ENABLE_CAL_PAGE
+              ApplXcpCalSegPublish();
+#endif
           }
           break;
 
+#ifdef XCP_ENABLE_BLOCK_MODE
+          case CC_DOWNLOAD_NEXT:
+          {
+              vuint8 size = CRO_DOWNLOAD_NEXT_SIZE; // Remaining data elements of the block
+              vuint8 n;
+              if (gXcp.DownloadRemaining == 0) error(CRC_SEQUENCE);
+              if (size != gXcp.DownloadRemaining) { // Packet lost, report the expected number of remaining data elements
+                  gXcp.CrmLen = CRM_DOWNLOAD_NEXT_ERR_SEQUENCE_LEN;
+                  CRM_CMD = PID_ERR;
+                  CRM_ERR = CRC_SEQUENCE;
+                  CRM_DOWNLOAD_NEXT_ERR_SEQUENCE_SIZE = gXcp.DownloadRemaining;
+                  gXcp.DownloadRemaining = 0;
+                  break;
+              }
+              n = (size > CRO_DOWNLOAD_NEXT_MAX_SIZE) ? CRO_DOWNLOAD_NEXT_MAX_SIZE : size;
+              err = XcpWriteMta(n, CRO_DOWNLOAD_NEXT_DATA);
+              if (err == XCP_CMD_DENIED) {
+                  gXcp.DownloadRemaining = 0;
+                  error(CRC_WRITE_PROTECTED);
+              }
+              gXcp.DownloadRemaining = (vuint8)(size - n);
+              if (gXcp.DownloadRemaining != 0) return; // Response after the last packet of the block
+#ifdef XCP_ENABLE_CAL_PAGE
+              ApplXcpCalSegPublish(); // The whole block becomes visible at once
+#endif
+          }
+          break;
+#endif
+
           case CC_SHORT_DOWNLOAD:
           {
               gXcp.Mta = ApplXcpGetPointer(CRO_SHORT_DOWNLOAD_EXT, CRO_SHORT_DOWNLOAD_ADDR);
@@ -638,13 +1606,26 @@ void  XcpCommand( const vuint32* pCommand )
               if (size > CRO_SHORT_DOWNLOAD_MAX_SIZE) error(CRC_OUT_OF_RANGE)
               err = XcpWriteMta(size, CRO_SHORT_DOWNLOAD_DATA);
               if (err == XCP_CMD_DENIED) error(CRC_WRITE_PROTECTED);
+#ifdef XCP_ENABLE_CAL_PAGE
+              ApplXcpCalSegPublish();
+#endif
           }
           break;
 
           case CC_UPLOAD:
             {
               vuint8 size = CRO_UPLOAD_SIZE;
+#ifdef XCP_ENABLE_BLOCK_MODE
+              // Slave block mode, transmit full packets directly, the last packet is the command response
+              while (size > (vuint8)CRM_UPLOAD_MAX_SIZE) {
+                  err = XcpReadMta(CRM_UPLOAD_MAX_SIZE, CRM_UPLOAD_DATA);
+                  if (err == XCP_CMD_DENIED) error(CRC_ACCESS_DENIED);
+                  ApplXcpSendCrm(&gXcp.Crm.b[0], (vuint8)(CRM_UPLOAD_LEN + CRM_UPLOAD_MAX_SIZE));
+                  size = (vuint8)(size - CRM_UPLOAD_MAX_SIZE);
+              }
+#else
               if (size > (vuint8)CRM_UPLOAD_MAX_SIZE) error(CRC_OUT_OF_RANGE);
+#endif
               err = XcpReadMta(size,CRM_UPLOAD_DATA);
               gXcp.CrmLen = (vuint8)(CRM_UPLOAD_LEN+size);
               if (err == XCP_CMD_PENDING) return; // No response
@@ -683,13 +1664,12 @@ void  XcpCommand( const vuint32* pCommand )
           case CC_BUILD_CHECKSUM: /* Build Checksum */
           {
               vuint32 n = CRO_BUILD_CHECKSUM_SIZE;
-              vuint32 s = 0;
-              vuint32 d,i;
+#if XCP_CHECKSUM_TYPE == XCP_CHECKSUM_TYPE_ADD44
               if (n % 4 != 0) error(CRC_OUT_OF_RANGE)
-              n = n / 4;
-              for (i = 0; i < n; i++) { XcpReadMta(4, (vuint8*)&d); s += d; }
-              CRM_BUILD_CHECKSUM_RESULT = s;
-              CRM_BUILD_CHECKSUM_TYPE = XCP_CHECKSUM_TYPE_ADD44;
+#endif
+              CRM_BUILD_CHECKSUM_RESULT = XcpChecksum(XCP_CHECKSUM_TYPE, gXcp.Mta, n);
+              gXcp.Mta += n;
+              CRM_BUILD_CHECKSUM_TYPE = XCP_CHECKSUM_TYPE;
               gXcp.CrmLen = CRM_BUILD_CHECKSUM_LEN;
           }
           break;
@@ -706,8 +1686,11 @@ void  XcpCommand( const vuint32* pCommand )
 #else
               CRM_GET_DAQ_PROCESSOR_INFO_MAX_EVENT = 0; /* Unknown */
 #endif    
-              CRM_GET_DAQ_PROCESSOR_INFO_DAQ_KEY_BYTE = (vuint8)DAQ_HDR_ODT_DAQB; /* DTO identification field type: Relative ODT number, absolute list number (BYTE) */
+              CRM_GET_DAQ_PROCESSOR_INFO_DAQ_KEY_BYTE = (vuint8)XCP_DAQ_HDR_TYPE; /* DTO identification field type: Relative ODT number, absolute list number (BYTE or WORD) */
               CRM_GET_DAQ_PROCESSOR_INFO_PROPERTIES = (vuint8)( DAQ_PROPERTY_CONFIG_TYPE | DAQ_PROPERTY_TIMESTAMP | DAQ_OVERLOAD_INDICATION_PID );
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+              CRM_GET_DAQ_PROCESSOR_INFO_PROPERTIES |= (vuint8)DAQ_PROPERTY_PRESCALER;
+#endif
             }
             break;
 
@@ -795,7 +1778,11 @@ void  XcpCommand( const vuint32* pCommand )
               if (daq >= gXcp.Daq.DaqCount) error(CRC_OUT_OF_RANGE);
               gXcp.CrmLen = CRM_GET_DAQ_LIST_MODE_LEN;
               CRM_GET_DAQ_LIST_MODE_MODE = DaqListFlags(daq);
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+              CRM_GET_DAQ_LIST_MODE_PRESCALER = DaqListPrescaler(daq) > 1 ? DaqListPrescaler(daq) : 1;
+#else
               CRM_GET_DAQ_LIST_MODE_PRESCALER = 1;
+#endif
               CRM_GET_DAQ_LIST_MODE_EVENTCHANNEL = (DaqListEventChannel(daq));
               CRM_GET_DAQ_LIST_MODE_PRIORITY = 0;  // DAQ-list prioritization is not supported
             }
@@ -807,10 +1794,14 @@ void  XcpCommand( const vuint32* pCommand )
               vuint16 event = CRO_SET_DAQ_LIST_MODE_EVENTCHANNEL;
               vuint8 mode = CRO_SET_DAQ_LIST_MODE_MODE;
               if (daq >= gXcp.Daq.DaqCount) error(CRC_OUT_OF_RANGE);
+              if (event >= XCP_MAX_EVENT) error(CRC_OUT_OF_RANGE); /* Event number out of event table range */
               if (mode & (DAQ_FLAG_NO_PID | DAQ_FLAG_RESUME | DAQ_FLAG_DIRECTION | DAQ_FLAG_CMPL_DAQ_CH | DAQ_FLAG_SELECTED | DAQ_FLAG_RUNNING)) error(CRC_OUT_OF_RANGE);  /* no pid, resume, stim not supported*/
               if (0==(mode & (DAQ_FLAG_TIMESTAMP| DAQ_FLAG_SELECTED))) error(CRC_OUT_OF_RANGE);  /* No timestamp not supported*/
               if (CRO_SET_DAQ_LIST_MODE_PRIORITY != 0) error(CRC_OUT_OF_RANGE);  /* Priorization is not supported */
-              XcpSetDaqListMode(daq, event, CRO_SET_DAQ_LIST_MODE_MODE);
+#ifndef XCP_ENABLE_DAQ_PRESCALER
+              if (CRO_SET_DAQ_LIST_MODE_PRESCALER > 1) error(CRC_OUT_OF_RANGE); /* Prescaler is not supported */
+#endif
+              XcpSetDaqListMode(daq, event, CRO_SET_DAQ_LIST_MODE_MODE, CRO_SET_DAQ_LIST_MODE_PRESCALER);
               break;
             }
 
@@ -1037,6 +2028,54 @@ void  XcpCommand( const vuint32* pCommand )
           }
           break; 
 
+#if defined(XCP_ENABLE_DAQ_ON_CHANGE) || defined(XCP_ENABLE_DAQ_RECORDER) || defined(XCP_ENABLE_CAL_PAGE)
+          case CC_USER_CMD:
+              switch (CRO_USER_CMD_SUBCOMMAND) {
+
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+              case CC_USER_SET_DAQ_LIST_ON_CHANGE:
+              {
+                  vuint16 daq = CRO_USER_SET_DAQ_LIST_ON_CHANGE_DAQ;
+                  vuint8 mode = CRO_USER_SET_DAQ_LIST_ON_CHANGE_MODE;
+                  if (daq >= gXcp.Daq.DaqCount) error(CRC_OUT_OF_RANGE);
+                  if (mode > 1) error(CRC_OUT_OF_RANGE);
+                  if (DaqListFlags(daq) & DAQ_FLAG_RUNNING) error(CRC_DAQ_ACTIVE);
+                  atomicStore32(&DaqListOnChange(daq), mode ? XCP_DAQ_ON_CHANGE_PENDING : XCP_DAQ_ON_CHANGE_OFF);
+                  gXcp.CopyPlanValid = 0; // Shadow copies are allocated with the copy plans
+              }
+              break;
+#endif
+
+#ifdef XCP_ENABLE_DAQ_RECORDER
+              case CC_USER_REC_ARM:
+                  if (!ApplXcpRecArm(CRO_USER_REC_ARM_DEPTH)) error(CRC_CMD_BUSY);
+                  break;
+
+              case CC_USER_REC_TRIGGER:
+                  if (!ApplXcpRecTrigger()) error(CRC_SEQUENCE);
+                  break;
+
+              case CC_USER_REC_STOP:
+                  ApplXcpRecStop();
+                  break;
+#endif
+
+#ifdef XCP_ENABLE_CAL_PAGE
+              case CC_USER_CAL_BEGIN:
+                  check_error(ApplXcpCalSegBegin());
+                  break;
+
+              case CC_USER_CAL_COMMIT:
+                  check_error(ApplXcpCalSegCommit());
+                  break;
+#endif
+
+              default: /* unknown user command */
+                  error(CRC_CMD_UNKNOWN);
+              }
+              break;
+#endif
+
 #if XCP_PROTOCOL_LAYER_VERSION >= 0x0104
           case CC_LEVEL_1_COMMAND:
               switch (CRO_LEVEL_1_COMMAND_CODE) {
@@ -1059,6 +2098,7 @@ void  XcpCommand( const vuint32* pCommand )
                   if (CRO_SET_DAQ_LIST_PACKED_MODE_MODE!=0x01) error(CRC_DAQ_CONFIG); // only element grouped implemented
                   //if (CRO_SET_DAQ_LIST_PACKED_MODE_TIMEMODE != 0x00) error(CRC_DAQ_CONFIG); // early or late timestamp implemented ?
                   DaqListSampleCount(daq) = CRO_SET_DAQ_LIST_PACKED_MODE_SAMPLECOUNT;
+                  gXcp.CopyPlanValid = 0;
               }
               break;
   #endif
@@ -1097,6 +2137,216 @@ void  XcpCommand( const vuint32* pCommand )
 }
 
 
+/****************************************************************************/
+/* Command queue                                                            */
+/****************************************************************************/
+
+#ifdef XCP_ENABLE_CMD_QUEUE
+
+// Long running commands, always executed by the command worker
+static vuint8 XcpIsLongRunningCommand(const tXcpCto* pCmd) {
+
+    switch (CRO_CMD) {
+    case CC_GET_ID: // May load a file
+    case CC_BUILD_CHECKSUM:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Time critical commands, answered immediately by the receiving thread
+static vuint8 XcpIsTimeCriticalCommand(const tXcpCto* pCmd) {
+
+    if (CRO_CMD == CC_SYNC || CRO_CMD == CC_GET_DAQ_CLOCK) return 1;
+#if XCP_PROTOCOL_LAYER_VERSION >= 0x0103 && defined(XCP_ENABLE_DAQ_CLOCK_MULTICAST)
+    if (CRO_CMD == CC_TRANSPORT_LAYER_CMD && CRO_TL_SUBCOMMAND == CC_TL_GET_DAQ_CLOCK_MULTICAST) return 1;
+#endif
+    return 0;
+}
+
+// The response of a time critical command is built in a local buffer, gXcp.Crm may be in use by the command worker
+#undef CRM_BYTE
+#undef CRM_WORD
+#undef CRM_DWORD
+#undef CRM_DDWORD
+#define CRM_BYTE(x)               (crm.b[x])
+#define CRM_WORD(x)               (crm.w[x])
+#define CRM_DWORD(x)              (crm.dw[x])
+#define CRM_DDWORD(x)             (*(vuint64*)&crm.dw[x])
+
+// Answer SYNC, GET_DAQ_CLOCK or GET_DAQ_CLOCK_MULTICAST, t is the receive time of the command
+static void XcpExecuteTimeCriticalCommand(const tXcpCto* pCmd, vuint64 t) {
+
+    tXcpCto crm;
+    vuint8 len;
+
+    if (CRO_CMD == CC_SYNC) {
+        len = CRM_SYNCH_LEN;
+        CRM_CMD = PID_ERR;
+        CRM_ERR = CRC_CMD_SYNCH;
+        ApplXcpSendCrm(&crm.b[0], len);
+        return;
+    }
+
+    CRM_CMD = PID_RES;
+#if XCP_PROTOCOL_LAYER_VERSION >= 0x0103
+    CRM_GET_DAQ_CLOCK_RES1 = 0x00; // Placeholder for event code
+    CRM_GET_DAQ_CLOCK_TRIGGER_INFO = 0x18; // TIME_OF_SAMPLING (Bitmask 0x18, 3 - Sampled on reception)
+    CRM_GET_DAQ_CLOCK_PAYLOAD_FMT = 0x01; // FMT_XCP_SLV = size of payload is DWORD
+    len = CRM_GET_DAQ_CLOCK_LEN;
+#ifdef XCP_ENABLE_DAQ_CLOCK_MULTICAST
+    if (CRO_CMD == CC_TRANSPORT_LAYER_CMD) { // GET_DAQ_CLOCK_MULTICAST
+        if (gXcp.ClusterId != CRO_DAQ_CLOCK_MCAST_CLUSTER_IDENTIFIER) {
+            len = 2;
+            CRM_CMD = PID_ERR;
+            CRM_ERR = CRC_OUT_OF_RANGE;
+            ApplXcpSendCrm(&crm.b[0], len);
+            return;
+        }
+        CRM_CMD = PID_EV;
+        CRM_EVENTCODE = EVC_TIME_SYNC;
+        CRM_GET_DAQ_CLOCK_TRIGGER_INFO = 0x18 + 0x02; // TIME_OF_SAMPLING (Bitmask 0x18, 3 - Sampled on reception) + TRIGGER_INITIATOR ( Bitmask 0x07, 2 - GET_DAQ_CLOCK_MULTICAST)
+#ifdef XCP_DAQ_CLOCK_64BIT
+        CRM_GET_DAQ_CLOCK_PAYLOAD_FMT = 0x42; // FMT_XCP_SLV = size of payload is DLONG + CLUSTER_ID
+        CRM_DAQ_CLOCK_MCAST_CLUSTER_IDENTIFIER64 = CRO_DAQ_CLOCK_MCAST_CLUSTER_IDENTIFIER;
+        CRM_DAQ_CLOCK_MCAST_COUNTER64 = CRO_DAQ_CLOCK_MCAST_COUNTER;
+        CRM_DAQ_CLOCK_MCAST_SYNC_STATE64 = 1;
+        len = CRM_GET_DAQ_CLOCK_LEN + 8;
+#else
+        CRM_GET_DAQ_CLOCK_PAYLOAD_FMT = 0x41; // FMT_XCP_SLV = size of payload is DWORD + CLUSTER_ID
+        CRM_DAQ_CLOCK_MCAST_CLUSTER_IDENTIFIER = CRO_DAQ_CLOCK_MCAST_CLUSTER_IDENTIFIER;
+        CRM_DAQ_CLOCK_MCAST_COUNTER = CRO_DAQ_CLOCK_MCAST_COUNTER;
+        CRM_DAQ_CLOCK_MCAST_SYNC_STATE = 1;
+        len = CRM_GET_DAQ_CLOCK_LEN + 4;
+#endif
+    }
+    else {
+#ifdef XCP_DAQ_CLOCK_64BIT
+        len = CRM_GET_DAQ_CLOCK_LEN + 5;
+        CRM_GET_DAQ_CLOCK_PAYLOAD_FMT = 0x2; // FMT_XCP_SLV = size of payload is DLONG
+        CRM_GET_DAQ_CLOCK_SYNC_STATE64 = 1;
+#else
+        len = CRM_GET_DAQ_CLOCK_LEN + 1;
+        CRM_GET_DAQ_CLOCK_SYNC_STATE = 1;
+#endif
+    }
+#endif
+    if (!(gXcp.SessionStatus & SS_LEGACY_MODE)) { // Extended format
+#ifdef XCP_DAQ_CLOCK_64BIT
+        CRM_GET_DAQ_CLOCK_TIME64 = t;
+#else
+        CRM_GET_DAQ_CLOCK_TIME = (vuint32)t;
+#endif
+    }
+    else
+#endif // >= 0x0103
+    { // Legacy format
+        len = CRM_GET_DAQ_CLOCK_LEN;
+        CRM_GET_DAQ_CLOCK_TIME = (vuint32)t;
+    }
+    ApplXcpSendCrm(&crm.b[0], len);
+}
+
+#undef CRM_BYTE
+#undef CRM_WORD
+#undef CRM_DWORD
+#undef CRM_DDWORD
+#define CRM_BYTE(x)               (gXcp.Crm.b[x])
+#define CRM_WORD(x)               (gXcp.Crm.w[x])
+#define CRM_DWORD(x)              (gXcp.Crm.dw[x])
+#define CRM_DDWORD(x)             (*(vuint64*)&gXcp.Crm.dw[x])
+
+// Discard the queued commands, which are not started yet
+static void XcpClearCommandQueue() {
+
+    mutexLock(&gXcp.CmdQueueMutex);
+    gXcp.CmdQueueHead = gXcp.CmdQueueTail;
+    mutexUnlock(&gXcp.CmdQueueMutex);
+}
+
+// Execute the next queued command, wait at most timeout_ms for a command to be queued
+// Returns 0, if there was no command
+int XcpHandleCommandQueue(vuint32 timeout_ms) {
+
+    tXcpCto cmd;
+
+    mutexLock(&gXcp.CmdQueueMutex);
+    if (gXcp.CmdQueueHead == gXcp.CmdQueueTail) condWait(&gXcp.CmdQueueCond, &gXcp.CmdQueueMutex, timeout_ms);
+    if (gXcp.CmdQueueHead == gXcp.CmdQueueTail) {
+        mutexUnlock(&gXcp.CmdQueueMutex);
+        return 0;
+    }
+    memcpy(&cmd, &gXcp.CmdQueue[gXcp.CmdQueueHead % XCP_CMD_QUEUE_SIZE], sizeof(cmd));
+    gXcp.CmdQueueHead++;
+    gXcp.CmdQueueBusy = 1;
+    mutexUnlock(&gXcp.CmdQueueMutex);
+
+    // Request the master to restart the timeout of a long running command
+    if (XcpIsLongRunningCommand(&cmd)) XcpSendEvent(EVC_CMD_PENDING, NULL, 0);
+    XcpExecuteCommand((const vuint32*)&cmd);
+
+    mutexLock(&gXcp.CmdQueueMutex);
+    gXcp.CmdQueueBusy = 0;
+    condSignalAll(&gXcp.CmdQueueCond);
+    mutexUnlock(&gXcp.CmdQueueMutex);
+    return 1;
+}
+
+#endif // XCP_ENABLE_CMD_QUEUE
+
+
+//  Handles incoming XCP commands
+//  With command queue, time critical commands are answered immediately, long running commands and all commands received while the command worker is busy are queued
+void  XcpCommand( const vuint32* pCommand )
+{
+#ifdef XCP_ENABLE_CMD_QUEUE
+  const tXcpCto* pCmd = (const tXcpCto*) pCommand;
+  vuint64 t = ApplXcpGetClock64(); // Receive time
+
+  if (XcpIsTimeCriticalCommand(pCmd)) {
+      if (!(gXcp.SessionStatus & SS_CONNECTED)) return; // No response when not connected
+#ifdef XCP_ENABLE_TESTMODE
+      if (ApplXcpDebugLevel >= 1) XcpPrintCmd(pCmd);
+#endif
+      if (CRO_CMD == CC_SYNC) XcpClearCommandQueue(); // Resynchronize after a timeout of the master
+      XcpExecuteTimeCriticalCommand(pCmd, t);
+      return;
+  }
+
+  // CONNECT resets the session, wait until the command worker is idle, the transport layer expects CONNECT to be executed synchronously
+  if (CRO_CMD == CC_CONNECT) {
+      XcpClearCommandQueue();
+      mutexLock(&gXcp.CmdQueueMutex);
+      while (gXcp.CmdQueueBusy) condWait(&gXcp.CmdQueueCond, &gXcp.CmdQueueMutex, 100);
+      mutexUnlock(&gXcp.CmdQueueMutex);
+  }
+
+  mutexLock(&gXcp.CmdQueueMutex);
+  if (gXcp.CmdQueueHead == gXcp.CmdQueueTail && !gXcp.CmdQueueBusy && !XcpIsLongRunningCommand(pCmd)) { // Command worker is idle, execute immediately
+      mutexUnlock(&gXcp.CmdQueueMutex);
+      XcpExecuteCommand(pCommand);
+      return;
+  }
+  if (gXcp.CmdQueueTail - gXcp.CmdQueueHead >= XCP_CMD_QUEUE_SIZE) { // Queue full
+      vuint8 crm[2] = { PID_ERR, CRC_CMD_BUSY };
+      mutexUnlock(&gXcp.CmdQueueMutex);
+      ApplXcpSendCrm(crm, 2);
+      return;
+  }
+  memcpy(&gXcp.CmdQueue[gXcp.CmdQueueTail % XCP_CMD_QUEUE_SIZE], pCommand, XCPTL_CTO_SIZE);
+  gXcp.CmdQueueTail++;
+  condSignalAll(&gXcp.CmdQueueCond); // Wake up the command worker
+  mutexUnlock(&gXcp.CmdQueueMutex);
+#ifdef XCP_ENABLE_TESTMODE
+  if (ApplXcpDebugLevel >= 2) ApplXcpPrint("Command %02Xh queued\n", CRO_CMD);
+#endif
+#else
+  XcpExecuteCommand(pCommand);
+#endif
+}
+
+
 /*****************************************************************************
 | Event
 ******************************************************************************/
@@ -1119,7 +2369,20 @@ void XcpSendEvent(vuint8 evc, const vuint8* d, vuint8 l)
 void  XcpInit( void )
 {
   /* Initialize all XCP variables to zero */
-  memset((vuint8*)&gXcp,0,(vuint16)sizeof(gXcp)); 
+#ifdef XCP_ENABLE_DYNAMIC_DAQ_MEM
+  if (gXcp.Daq.pMem != NULL) free(gXcp.Daq.pMem);
+  XcpFreeRetiredDaqMemory();
+#endif
+  memset((vuint8*)&gXcp,0,sizeof(gXcp)); 
+
+#ifdef XCP_ENABLE_CMD_QUEUE
+  mutexInit(&gXcp.CmdQueueMutex, 0, 1000);
+  condInit(&gXcp.CmdQueueCond);
+#endif
+
+#ifdef XCP_ENABLE_AVX2
+  gXcp.CpuAvx2 = XcpCpuHasAvx2();
+#endif
    
 #if XCP_PROTOCOL_LAYER_VERSION >= 0x0103
 
@@ -1197,6 +2460,14 @@ static void  XcpPrintCmd(const tXcpCto * pCmd) {
         }
         break;
 
+#ifdef XCP_ENABLE_BLOCK_MODE
+    case CC_DOWNLOAD_NEXT:
+        if (ApplXcpDebugLevel >= 2) {
+            ApplXcpPrint("DOWNLOAD_NEXT size=%u\n", CRO_DOWNLOAD_NEXT_SIZE);
+        }
+        break;
+#endif
+
     case CC_SHORT_DOWNLOAD:
         if (ApplXcpDebugLevel >= 2) {
             vuint16 i;
@@ -1256,6 +2527,10 @@ static void  XcpPrintCmd(const tXcpCto * pCmd) {
             ApplXcpPrint("GET_STATUS\n");
             break;
 
+    case CC_SET_REQUEST:
+            ApplXcpPrint("SET_REQUEST mode=%02Xh\n", CRO_SET_REQUEST_MODE);
+            break;
+
      case CC_GET_DAQ_PROCESSOR_INFO:
             ApplXcpPrint("GET_DAQ_PROCESSOR_INFO\n");
             break;
@@ -1291,9 +2566,35 @@ static void  XcpPrintCmd(const tXcpCto * pCmd) {
             break;
 
      case CC_SET_DAQ_LIST_MODE:
-            ApplXcpPrint("SET_DAQ_LIST_MODE daq=%u, mode=%02Xh, eventchannel=%u\n",CRO_SET_DAQ_LIST_MODE_DAQ, CRO_SET_DAQ_LIST_MODE_MODE, CRO_SET_DAQ_LIST_MODE_EVENTCHANNEL);
+            ApplXcpPrint("SET_DAQ_LIST_MODE daq=%u, mode=%02Xh, eventchannel=%u, prescaler=%u\n",CRO_SET_DAQ_LIST_MODE_DAQ, CRO_SET_DAQ_LIST_MODE_MODE, CRO_SET_DAQ_LIST_MODE_EVENTCHANNEL, CRO_SET_DAQ_LIST_MODE_PRESCALER);
             break;
            
+#if defined(XCP_ENABLE_DAQ_ON_CHANGE) || defined(XCP_ENABLE_DAQ_RECORDER) || defined(XCP_ENABLE_CAL_PAGE)
+     case CC_USER_CMD:
+            if (CRO_USER_CMD_SUBCOMMAND == CC_USER_SET_DAQ_LIST_ON_CHANGE) {
+                ApplXcpPrint("USER_CMD SET_DAQ_LIST_ON_CHANGE daq=%u, mode=%u\n", CRO_USER_SET_DAQ_LIST_ON_CHANGE_DAQ, CRO_USER_SET_DAQ_LIST_ON_CHANGE_MODE);
+            }
+            else if (CRO_USER_CMD_SUBCOMMAND == CC_USER_REC_ARM) {
+                ApplXcpPrint("USER_CMD REC_ARM depth=%ums\n", CRO_USER_REC_ARM_DEPTH);
+            }
+            else if (CRO_USER_CMD_SUBCOMMAND == CC_USER_REC_TRIGGER) {
+                ApplXcpPrint("USER_CMD REC_TRIGGER\n");
+            }
+            else if (CRO_USER_CMD_SUBCOMMAND == CC_USER_REC_STOP) {
+                ApplXcpPrint("USER_CMD REC_STOP\n");
+            }
+            else if (CRO_USER_CMD_SUBCOMMAND == CC_USER_CAL_BEGIN) {
+                ApplXcpPrint("USER_CMD CAL_BEGIN\n");
+            }
+            else if (CRO_USER_CMD_SUBCOMMAND == CC_USER_CAL_COMMIT) {
+                ApplXcpPrint("USER_CMD CAL_COMMIT\n");
+            }
+            else {
+                ApplXcpPrint("USER_CMD %02Xh\n", CRO_USER_CMD_SUBCOMMAND);
+            }
+            break;
+#endif
+
      case CC_SET_DAQ_PTR:
             if (ApplXcpDebugLevel >= 2) {
                 ApplXcpPrint("SET_DAQ_PTR daq=%u,odt=%u,idx=%u\n", CRO_SET_DAQ_PTR_DAQ, CRO_SET_DAQ_PTR_ODT, CRO_SET_DAQ_PTR_IDX);
@@ -1421,7 +2722,7 @@ static void  XcpPrintRes(const tXcpCto* pCmd) {
         case CC_UPLOAD:
             if (ApplXcpDebugLevel >= 3) {
                 ApplXcpPrint("<- data=");
-                for (int i = 0; i < CRO_UPLOAD_SIZE; i++) {
+                for (int i = 0; i < gXcp.CrmLen-CRM_UPLOAD_LEN; i++) { // Last packet in slave block mode
                     ApplXcpPrint("%02Xh ", CRM_UPLOAD_DATA[i]);
                 }
                 ApplXcpPrint("\n");
@@ -1559,7 +2860,7 @@ static void XcpPrintDaqList( vuint16 daq )
 #endif
   for (i=DaqListFirstOdt(daq);i<=DaqListLastOdt(daq);i++) {
     ApplXcpPrint("  ODT %u (%u):",i-DaqListFirstOdt(daq),i);
-    ApplXcpPrint(" firstOdtEntry=%u, lastOdtEntry=%u, size=%u:\n", DaqListOdtFirstEntry(i), DaqListOdtLastEntry(i),DaqListOdtSize(i));
+    ApplXcpPrint(" firstOdtEntry=%u, lastOdtEntry=%u, size=%u, copyOps=%u:\n", DaqListOdtFirstEntry(i), DaqListOdtLastEntry(i),DaqListOdtSize(i),DaqListOdtCopyOpCount(i));
     for (e=DaqListOdtFirstEntry(i);e<=DaqListOdtLastEntry(i);e++) {
       ApplXcpPrint("   %08X,%u\n",OdtEntryAddr(e), OdtEntrySize(e));
     }
@@ -589,6 +589,9 @@
 #define CRO_DOWNLOAD_NEXT_SIZE                          CRO_BYTE(1)
 #define CRO_DOWNLOAD_NEXT_DATA                          (&CRO_BYTE(2))
 #define CRM_DOWNLOAD_NEXT_LEN                           1
+#define CRM_DOWNLOAD_NEXT_ERR_SEQUENCE_LEN              3
+#define CRM_DOWNLOAD_NEXT_ERR_SEQUENCE_SIZE             CRM_BYTE(2) /* Expected number of remaining data elements */
+#define XCP_MAX_BS ((255+CRO_DOWNLOAD_NEXT_MAX_SIZE-1)/CRO_DOWNLOAD_NEXT_MAX_SIZE) /* Packets of the largest master block, the number of data elements is a byte */
 
                                                         
 /* DOWNLOAD_MAX */
@@ -1026,6 +1029,27 @@
 #define CRO_SET_DAQ_LIST_PACKED_MODE_SAMPLECOUNT            CRO_WORD(3)
 
 
+/* USER_CMD */
+#define CRO_USER_CMD_SUBCOMMAND                             CRO_BYTE(1)
+
+/* USER_CMD sub commands */
+#define CC_USER_SET_DAQ_LIST_ON_CHANGE                      0x01
+#define CC_USER_REC_ARM                                     0x02
+#define CC_USER_REC_TRIGGER                                 0x03
+#define CC_USER_REC_STOP                                    0x04
+#define CC_USER_CAL_BEGIN                                   0x05
+#define CC_USER_CAL_COMMIT                                  0x06
+
+/* USER_CMD SET_DAQ_LIST_ON_CHANGE */
+#define CRO_USER_SET_DAQ_LIST_ON_CHANGE_LEN                 6
+#define CRO_USER_SET_DAQ_LIST_ON_CHANGE_MODE                CRO_BYTE(2) /* 0 = transmit on every event, 1 = transmit only when data changed */
+#define CRO_USER_SET_DAQ_LIST_ON_CHANGE_DAQ                 CRO_WORD(2)
+
+/* USER_CMD REC_ARM */
+#define CRO_USER_REC_ARM_LEN                                8
+#define CRO_USER_REC_ARM_DEPTH                              CRO_DWORD(1) /* Pre-trigger depth in ms, 0 = limited by the ring buffer size */
+
+
 /* TIME SYNCHRONIZATION PROPERTIES*/
 #define CRO_TIME_SYNC_PROPERTIES_LEN                        6
 #define CRO_TIME_SYNC_PROPERTIES_SET_PROPERTIES             CRO_BYTE(1)
@@ -1202,6 +1226,22 @@
 #error "Please define XCP_DAQ_MEM_SIZE"
 #endif
 
+/* Alignment of the DAQ memory and the arrays in the DAQ memory */
+#if !defined ( XCP_DAQ_MEM_ALIGNMENT )
+#define XCP_DAQ_MEM_ALIGNMENT 64 // Cache line size
+#endif
+
+/* DTO identification field (ODT,DAQ header) */
+#ifdef XCP_ENABLE_DAQ_HDR_ODT_FIL_DAQW
+#define XCP_DAQ_HDR_TYPE DAQ_HDR_ODT_FIL_DAQW // Relative ODT number (BYTE), fill byte, absolute DAQ list number (WORD)
+#define XCP_DAQ_HDR_SIZE 4
+#define XCP_MAX_DAQ_COUNT 0xFFFE // XCP_UNDEFINED_DAQ_LIST is reserved
+#else
+#define XCP_DAQ_HDR_TYPE DAQ_HDR_ODT_DAQB // Relative ODT number (BYTE), absolute DAQ list number (BYTE)
+#define XCP_DAQ_HDR_SIZE 2
+#define XCP_MAX_DAQ_COUNT 255
+#endif
+
 /* Check configuration of XCP_TIMESTAMP_UNIT. */
 #if defined ( XCP_TIMESTAMP_UNIT )
 #if ( (XCP_TIMESTAMP_UNIT >> 4) > 9 ) || ( (XCP_TIMESTAMP_UNIT & 0x0F) > 0 )
@@ -1240,35 +1280,83 @@ typedef union {
 
 /* ODT */
 /* Size must be even !!! */
+/* Fields used by the DAQ copy plan path first, the ODT entry range is used by the DAQ setup and the entry by entry fallback */
 typedef struct {
+  vuint16 size;                /* Number of bytes */
+  vuint16 copyOpCount;         /* Number of copy plan operations, 0 if there is no copy plan */
+  vuint16 firstCopyOp;         /* Absolute copy plan operation number */
   vuint16 firstOdtEntry;       /* Absolute odt entry number */
   vuint16 lastOdtEntry;        /* Absolute odt entry number */
-  vuint16 size;                /* Number of bytes */
+  vuint16 res;
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+  vuint32 shadow;              /* Offset of the shadow copy of the ODT data in the DAQ memory, 0 if there is none */
+#endif
 } tXcpOdt;
 
+/* ODT copy plan operation */
+/* XCP_COPY_OP_COPY copies a contiguous range of merged ODT entries */
+/* XCP_COPY_OP_GATHER32 gathers size/4 scattered 4 byte ODT entries, the source addresses follow as a vuint32 array in the next (size/4+1)/2 operations */
+typedef struct {
+  vuint32 addr;                /* Source address */
+  vuint16 size;                /* Number of bytes, sample count of packed mode included */
+  vuint16 type;                /* XCP_COPY_OP_xxx */
+} tXcpCopyOp;
+
+#define XCP_COPY_OP_COPY      0
+#define XCP_COPY_OP_GATHER32  1
+
 
 /* DAQ list */
 typedef struct {
   vuint16 lastOdt;             /* Absolute odt number */
   vuint16 firstOdt;            /* Absolute odt number */
   vuint16 eventChannel; 
+  vuint16 nextDaq;             /* Next running DAQ list of the same event, XCP_UNDEFINED_DAQ_LIST if last */
 #ifdef XCP_ENABLE_PACKED_MODE
   vuint16 sampleCount;         /* Packed mode */
 #endif
   vuint8 flags;
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+  vuint8 prescaler;            /* Sample every prescaler-th event, 1 = every event */
+#else
   vuint8 res;
+#endif
+  vuint32 overrun;             /* Event skipped on DTO buffer overflow, indicated in the next ODT, set and cleared atomically */
+#ifdef XCP_ENABLE_DAQ_PRESCALER
+  vuint32 prescalerCount;      /* Decimation counter, number of events since DAQ start, incremented atomically */
+#endif
+#ifdef XCP_ENABLE_DAQ_ON_CHANGE
+  vuint32 onChange;            /* XCP_DAQ_ON_CHANGE_xxx, set and cleared atomically */
+#endif
 } tXcpDaqList;
 
+/* DAQ list on change mode */
+#define XCP_DAQ_ON_CHANGE_OFF     0 /* Transmit on every event */
+#define XCP_DAQ_ON_CHANGE_ON      1 /* Transmit only, when the data of any ODT of the DAQ list changed */
+#define XCP_DAQ_ON_CHANGE_PENDING 2 /* Transmit on the next event, then continue with XCP_DAQ_ON_CHANGE_ON */
+
+#define XCP_UNDEFINED_DAQ_LIST 0xFFFF
+
 
 /* Dynamic DAQ list structures */
 typedef struct {
   vuint16         DaqCount;
   vuint16         OdtCount;       /* Absolute */
   vuint16         OdtEntryCount;  /* Absolute */
+#ifdef XCP_ENABLE_DYNAMIC_DAQ_MEM
+  vuint32         MemSize;        /* Size of the DAQ memory, grows on demand up to XCP_DAQ_MEM_SIZE */
+  void*           pMem;           /* Heap allocation of the DAQ memory, u.b is aligned to XCP_DAQ_MEM_ALIGNMENT */
+  void*           pRetiredMem;    /* Previous heap allocations, event threads may still read them, released in XcpInit */
+  union { 
+    vuint8*       b;
+    tXcpDaqList*  DaqList; 
+  } u;
+#else
   union { 
     vuint8        b[XCP_DAQ_MEM_SIZE];
     tXcpDaqList   DaqList[XCP_DAQ_MEM_SIZE/sizeof(tXcpDaqList)]; 
   } u;
+#endif
 } tXcpDaq;
 
 
@@ -1289,6 +1377,9 @@ typedef struct {
 #define DaqListOdtLastEntry(j)  (gXcp.pOdt[j].lastOdtEntry)
 #define DaqListOdtFirstEntry(j) (gXcp.pOdt[j].firstOdtEntry)
 #define DaqListOdtSize(j)       (gXcp.pOdt[j].size)
+#define DaqListOdtCopyOpCount(j) (gXcp.pOdt[j].copyOpCount)
+#define DaqListOdtFirstCopyOp(j) (gXcp.pOdt[j].firstCopyOp)
+#define DaqListOdtShadow(j)     (gXcp.pOdt[j].shadow)
 
 /* n is absolute odtEntry number */
 #define OdtEntrySize(n)         (gXcp.pOdtEntrySize[n])
@@ -1300,8 +1391,20 @@ typedef struct {
 #define DaqListFirstOdt(i)      gXcp.Daq.u.DaqList[i].firstOdt
 #define DaqListFlags(i)         gXcp.Daq.u.DaqList[i].flags
 #define DaqListEventChannel(i)  gXcp.Daq.u.DaqList[i].eventChannel
+#define DaqListNext(i)          gXcp.Daq.u.DaqList[i].nextDaq
+#define DaqListOverrun(i)       gXcp.Daq.u.DaqList[i].overrun
+#define DaqListPrescaler(i)     gXcp.Daq.u.DaqList[i].prescaler
+#define DaqListPrescalerCount(i) gXcp.Daq.u.DaqList[i].prescalerCount
+#define DaqListOnChange(i)      gXcp.Daq.u.DaqList[i].onChange
 #define DaqListSampleCount(i)    gXcp.Daq.u.DaqList[i].sampleCount
 
+/* Size of the DAQ memory */
+#ifdef XCP_ENABLE_DYNAMIC_DAQ_MEM
+#define XcpDaqMemSize()         (gXcp.Daq.MemSize)
+#else
+#define XcpDaqMemSize()         ((vuint32)XCP_DAQ_MEM_SIZE)
+#endif
+
 
 /* Return values */
 #define XCP_CMD_DENIED              0
@@ -1390,6 +1493,19 @@ typedef struct {
     vuint8 SessionStatus;
 
     vuint8* Mta;                        /* Memory Transfer Address */
+#ifdef XCP_ENABLE_BLOCK_MODE
+    vuint8 DownloadRemaining;           /* Master block mode, data elements of the current DOWNLOAD block still expected by DOWNLOAD_NEXT */
+#endif
+
+#ifdef XCP_ENABLE_CMD_QUEUE
+    /* Command queue, executed in order by the command worker, protected by CmdQueueMutex */
+    tXcpCto CmdQueue[XCP_CMD_QUEUE_SIZE];
+    vuint32 CmdQueueHead;               /* Number of commands taken by the command worker */
+    vuint32 CmdQueueTail;               /* Number of commands queued */
+    vuint8 CmdQueueBusy;                /* Command worker is executing a command */
+    MUTEX CmdQueueMutex;
+    COND CmdQueueCond;                  /* Signaled when a command is queued or the command worker is done */
+#endif
 
     /*
       Dynamic DAQ list structures
@@ -1399,9 +1515,18 @@ typedef struct {
     tXcpOdt* pOdt;
     vuint32* pOdtEntryAddr;
     vuint8* pOdtEntrySize;
+    tXcpCopyOp* pCopyOp; /* ODT copy plans, in the free DAQ memory behind the ODT entries */
+    vuint8 CopyPlanValid; /* ODT copy plans are up to date */
+#if defined ( XCP_ENABLE_DAQ_GATHER ) || defined ( XCP_ENABLE_CHECKSUM )
+    vuint8 CpuAvx2; /* CPU supports the AVX2 gather and checksum kernels, detected in XcpInit */
+#endif
 
     vuint64 DaqStartClock64;
-    vuint32 DaqOverflowCount;
+    vuint32 DaqOverflowCount; /* Events skipped on DTO buffer overflow, incremented atomically */
+    vuint32 EventOverflowCount[XCP_MAX_EVENT]; /* Events skipped on DTO buffer overflow per event, incremented atomically */
+
+    /* Running DAQ lists of each event, first DAQ list of the chain linked by nextDaq, XCP_UNDEFINED_DAQ_LIST if none */
+    vuint16 EventDaqFirst[XCP_MAX_EVENT];
 
     /* State info from SET_DAQ_PTR for WRITE_DAQ and WRITE_DAQ_MULTIPLE */
     vuint16 WriteDaqOdtEntry;
@@ -1437,12 +1562,18 @@ extern void XcpInit( void );
 extern void XcpDisconnect();
 
 /* Trigger a XCP data acquisition or stimulation event */
+/* Thread safe, different threads may trigger the same or different events in parallel */
+/* The only shared state written is the DTO buffer reservation in the transport layer and atomic overflow indications */
 extern void XcpEvent(vuint16 event); 
 extern void XcpEventExt(vuint16 event, vuint8* base);
 extern void XcpEventAt(vuint16 event, vuint64 clock );
 
 /* XCP command processor */
 extern void XcpCommand( const vuint32* pCommand );
+#ifdef XCP_ENABLE_CMD_QUEUE
+/* Execute the next queued command, called cyclically by the command worker thread, returns 0 if the queue is empty */
+extern int XcpHandleCommandQueue(vuint32 timeout_ms);
+#endif
 
 /* Send an XCP event message */
 extern void XcpSendEvent(vuint8 evc, const vuint8* d, vuint8 l);
@@ -1451,6 +1582,28 @@ extern void XcpSendEvent(vuint8 evc, const vuint8* d, vuint8 l);
 extern vuint8 XcpIsConnected();
 extern vuint8 XcpIsDaqRunning();
 extern vuint8 XcpIsDaqPacked();
+extern vuint32 XcpGetDaqOverflowCount();
+extern vuint32 XcpGetEventOverflowCount(vuint16 event);
+
+/* DAQ list configuration by the application, when no XCP master is connected */
+extern void XcpFreeDaq( void );
+extern vuint8 XcpAllocDaq( vuint16 daqCount );
+extern vuint8 XcpAllocOdt( vuint16 daq, vuint8 odtCount );
+extern vuint8 XcpAllocOdtEntry( vuint16 daq, vuint8 odt, vuint8 odtEntryCount );
+extern vuint8 XcpSetDaqPtr( vuint16 daq, vuint8 odt, vuint8 idx );
+extern vuint8 XcpAddOdtEntry( vuint32 addr, vuint8 ext, vuint8 size );
+extern void XcpSetDaqListMode( vuint16 daq, vuint16 event, vuint8 mode, vuint8 prescaler );
+extern void XcpStartAllSelectedDaq( void );
+extern void XcpStopAllDaq( void );
+
+#ifdef XCP_ENABLE_BENCHMARK
+/* Measure the DAQ sampling time of an event for the given ODT entries split into daqCount DAQ lists on 2 events, overwrites the DAQ configuration */
+extern int XcpDaqBenchmark(const char* name, vuint32 count, const vuint32* addr, const vuint8* size, vuint16 daqCount, vuint32 loops);
+#ifdef XCP_ENABLE_CHECKSUM
+/* Measure the BUILD_CHECKSUM throughput of all checksum types */
+extern int XcpChecksumBenchmark(vuint32 size, vuint32 loops);
+#endif
+#endif
 
 /* Time synchronisation */
 extern vuint16 XcpGetClusterId();
@@ -1543,6 +1696,18 @@ extern vuint8 *ApplXcpGetBaseAddr();
 #ifdef XCP_ENABLE_CAL_PAGE
 extern vuint8 ApplXcpGetCalPage(vuint8 segment, vuint8 mode);
 extern vuint8 ApplXcpSetCalPage(vuint8 segment, vuint8 page, vuint8 mode);
+/* Check a write access to calibration memory, returns 0 if write protected */
+extern vuint8 ApplXcpCheckWriteAccess(const vuint8* p, vuint8 size);
+/* Make the calibration memory modified by downloads visible to the ECU */
+extern void ApplXcpCalSegPublish();
+/* Calibration transaction, publishing is deferred until commit, returns 0 or an error code */
+extern vuint8 ApplXcpCalSegBegin();
+extern vuint8 ApplXcpCalSegCommit();
+#endif
+
+#ifdef XCP_ENABLE_CAL_STORE
+/* Request to persist the calibration, returns 0 or an error code */
+extern vuint8 ApplXcpCalStoreRequest();
 #endif
 
 #ifdef XCP_ENABLE_GRANDMASTER_CLOCK_INFO
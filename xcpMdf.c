@@ -0,0 +1,873 @@
+/*----------------------------------------------------------------------------
+| File:
+|   xcpMdf.c
+|
+| Description:
+|   On target DAQ recorder to a local MDF4 file
+|   Linux version
+|   Creates DAQ lists for the signals registered by the A2L generator, without XCP master
+|   DTO messages of XcpEvent are passed through a lock free ring to a writer thread,
+|   which assembles the MDF records and writes the file in large aligned blocks (O_DIRECT)
+|
+| Copyright (c) Vector Informatik GmbH. All rights reserved.
+| Licensed under the MIT license. See LICENSE file in the project root for details.
+|
+ ----------------------------------------------------------------------------*/
+
+#include "configuration.h"
+#include "xcpAppl.h"
+
+#ifdef XCP_ENABLE_MDF_RECORDER
+
+#define MDF_BLOCK_ALIGNMENT 4096 // O_DIRECT buffer, size and file offset alignment
+#define MDF_MAX_ODT 0x7C // Relative ODT numbers of a DAQ list, BIT7 of the ODT byte indicates overruns
+#define MDF_ODT_NONE 0xFFFF
+#define MDF_RECORD_ID_SIZE 2 // Record id of an unsorted data group is the DAQ list number + 1
+#define MDF_ALIGN8(n) (((n) + 7) & ~(uint64_t)7)
+
+// MDF4 unfinalized flags
+#define MDF_UNFIN_CG_CYCLE_COUNT 0x0001
+#define MDF_UNFIN_DT_LENGTH 0x0004
+
+// MDF4 ID block
+typedef struct {
+    char file_id[8];
+    char format_id[8];
+    char program_id[8];
+    uint8_t res1[4];
+    uint16_t version;
+    uint8_t res2[30];
+    uint16_t unfin_flags;
+    uint16_t custom_unfin_flags;
+} tMdfId;
+
+// MDF4 block header
+typedef struct {
+    char id[4];
+    uint32_t res;
+    uint64_t length;
+    uint64_t link_count;
+} tMdfHeader;
+
+// MDF4 block data sections
+#define MDF_HD_LINKS 6 // dg_first, fh_first, ch_first, at_first, ev_first, md_comment
+typedef struct {
+    uint64_t start_time_ns;
+    int16_t tz_offset_min;
+    int16_t dst_offset_min;
+    uint8_t time_flags;
+    uint8_t time_class;
+    uint8_t flags;
+    uint8_t res;
+    double start_angle_rad;
+    double start_distance_m;
+} tMdfHd;
+
+#define MDF_DG_LINKS 4 // dg_next, cg_first, data, md_comment
+typedef struct {
+    uint8_t rec_id_size;
+    uint8_t res[7];
+} tMdfDg;
+
+#define MDF_CG_LINKS 6 // cg_next, cn_first, tx_acq_name, si_acq_source, sr_first, md_comment
+typedef struct {
+    uint64_t record_id;
+    uint64_t cycle_count;
+    uint16_t flags;
+    uint16_t path_separator;
+    uint32_t res;
+    uint32_t data_bytes;
+    uint32_t inval_bytes;
+} tMdfCg;
+
+#define MDF_CN_LINKS 8 // cn_next, composition, tx_name, si_source, cc_conversion, data, md_unit, md_comment
+typedef struct {
+    uint8_t type;
+    uint8_t sync_type;
+    uint8_t data_type;
+    uint8_t bit_offset;
+    uint32_t byte_offset;
+    uint32_t bit_count;
+    uint32_t flags;
+    uint32_t inval_bit_pos;
+    uint8_t precision;
+    uint8_t res;
+    uint16_t attachment_count;
+    double val_range_min;
+    double val_range_max;
+    double limit_min;
+    double limit_max;
+    double limit_ext_min;
+    double limit_ext_max;
+} tMdfCn;
+
+#define MDF_CC_LINKS 4 // tx_name, md_unit, md_comment, cc_inverse
+typedef struct {
+    uint8_t type;
+    uint8_t precision;
+    uint16_t flags;
+    uint16_t ref_count;
+    uint16_t val_count;
+    double phy_range_min;
+    double phy_range_max;
+    double val[2];
+} tMdfCc;
+
+// MDF4 data types and channel types
+#define MDF_DT_UINT_LE 0
+#define MDF_DT_INT_LE 2
+#define MDF_DT_FLOAT_LE 4
+#define MDF_CN_VALUE 0
+#define MDF_CN_MASTER 2
+#define MDF_SYNC_NONE 0
+#define MDF_SYNC_TIME 1
+#define MDF_CC_LINEAR 1
+
+// Signal
+typedef struct {
+    char* name;
+    char* unit;
+    char* comment;
+    uint32_t addr;
+    int type; // A2L_TYPE_xxx
+    uint16_t event;
+    double factor;
+    double offset;
+    // Layout of the current recording
+    uint16_t daq;
+    uint16_t odt;
+    uint32_t recordOffset; // Byte offset in the record, after the time channel
+} tMdfSignal;
+
+// DAQ list, one for each event with signals, one channel group in the MDF file
+typedef struct {
+    uint16_t event;
+    uint16_t odtCount;
+    uint16_t odtSize[MDF_MAX_ODT];
+    uint8_t odtEntryCount[MDF_MAX_ODT];
+    uint32_t odtOffset[MDF_MAX_ODT]; // Byte offset of the ODT data in the record, after the time channel
+    uint32_t size; // Data bytes of all ODTs
+    // Record assembly in the writer thread
+    uint8_t* record; // Record id, time channel and ODT data
+    uint16_t nextOdt; // Next expected ODT of the record, MDF_ODT_NONE if waiting for ODT 0
+    uint64_t clock; // Last timestamp, extended to 64 bit
+    uint64_t cycleCount;
+    uint64_t cgPos; // File position of the channel group block
+} tMdfDaq;
+
+static struct {
+
+    // Signals
+    tMdfSignal signals[XCP_MDF_MAX_SIGNALS];
+    uint32_t signalCount;
+
+    // DAQ lists of the current recording
+    tMdfDaq* daq;
+    uint16_t daqCount;
+
+    // DTO message ring, multiple producers in XcpEvent, the writer thread is the single reader
+    tMdfSlot* slots;
+    volatile uint64_t wp __attribute__((aligned(64))); // Number of reserved slots
+    volatile uint64_t rp __attribute__((aligned(64))); // Number of read slots
+
+    // Writer thread
+    volatile uint32_t active; // DTO messages are routed into the ring
+    volatile uint32_t running; // Writer thread is running
+    tXcpThread thread;
+
+    // File
+    int fd;
+    int direct; // O_DIRECT
+    uint8_t* block; // Aligned write buffer
+    uint32_t blockLen;
+    uint64_t fileSize; // Bytes appended
+    uint64_t dtPos; // File position of the data block
+    uint64_t startClock;
+    int error;
+
+    // Metadata, built in memory before the recording starts
+    uint8_t* meta;
+    uint32_t metaLen;
+    uint32_t metaSize;
+
+    // Dropped samples
+    uint32_t droppedCount; // Incomplete records
+    uint32_t invalidCount; // Unexpected DTO messages
+
+} gMdf;
+
+// Serializes start and stop of the recorder with CONNECT of a XCP master
+static MUTEX gMdfMutex = MUTEX_INTIALIZER;
+
+#define MDF_SLOT(pos) (&gMdf.slots[(pos) % XCP_MDF_SLOT_COUNT])
+#define MDF_IS_SLOT(p) (gMdf.slots != NULL && (tMdfSlot*)(p) >= &gMdf.slots[0] && (tMdfSlot*)(p) < &gMdf.slots[XCP_MDF_SLOT_COUNT])
+
+
+//------------------------------------------------------------------------------
+// Signals
+
+static char* mdfStrDup(const char* s) {
+
+    char* d;
+    if (s == NULL || *s == 0) return NULL;
+    d = (char*)malloc(strlen(s) + 1);
+    if (d != NULL) strcpy(d, s);
+    return d;
+}
+
+// Register a signal for recording
+// type is the A2L_TYPE_xxx code
+// Measurements of typedef instances or arrays are not supported
+int mdfCreateSignal(const char* instanceName, const char* name, int type, uint32_t addr, uint16_t event, double factor, double offset, const char* unit, const char* comment) {
+
+    tMdfSignal* s;
+    char fullName[256];
+
+    if (gMdf.signalCount >= XCP_MDF_MAX_SIGNALS) {
+        printf("ERROR: too many MDF recorder signals!\n");
+        return 0;
+    }
+    if (type != 8 && type != 10 && type != -10 && (type < -4 || type > 4 || type == 0 || type == 3 || type == -3)) return 0; // Unknown type
+    if (instanceName != NULL && strlen(instanceName) > 0) {
+        snprintf(fullName, sizeof(fullName), "%s.%s", instanceName, name);
+    }
+    else {
+        snprintf(fullName, sizeof(fullName), "%s", name);
+    }
+    s = &gMdf.signals[gMdf.signalCount];
+    s->name = mdfStrDup(fullName);
+    s->unit = mdfStrDup(unit);
+    s->comment = mdfStrDup(comment);
+    if (s->name == NULL) return 0;
+    s->addr = addr;
+    s->type = type;
+    s->event = event;
+    s->factor = factor;
+    s->offset = offset;
+    gMdf.signalCount++;
+    return 1;
+}
+
+void mdfClearSignals() {
+
+    uint32_t i;
+    if (gMdf.active) return;
+    for (i = 0; i < gMdf.signalCount; i++) {
+        free(gMdf.signals[i].name);
+        free(gMdf.signals[i].unit);
+        free(gMdf.signals[i].comment);
+    }
+    gMdf.signalCount = 0;
+}
+
+static uint32_t mdfSignalSize(const tMdfSignal* s) {
+
+    if (s->type == 10 || s->type == -10) return 8;
+    return (uint32_t)(s->type < 0 ? -s->type : s->type);
+}
+
+static uint8_t mdfSignalDataType(const tMdfSignal* s) {
+
+    if (s->type == 8) return MDF_DT_FLOAT_LE;
+    return s->type < 0 ? MDF_DT_INT_LE : MDF_DT_UINT_LE;
+}
+
+
+//------------------------------------------------------------------------------
+// DAQ lists
+
+// Assign the signals to DAQ lists and ODTs, one DAQ list for each event
+static int mdfCreateDaqLists() {
+
+    uint16_t events[XCP_MAX_EVENT];
+    uint16_t daq, odt, i;
+    uint32_t j, n, cap;
+    tMdfSignal* s;
+    tMdfDaq* l;
+    int cur;
+
+    // Events with signals
+    gMdf.daqCount = 0;
+    for (j = 0; j < gMdf.signalCount; j++) {
+        for (i = 0; i < gMdf.daqCount; i++) if (events[i] == gMdf.signals[j].event) break;
+        if (i == gMdf.daqCount) {
+            if (gMdf.daqCount >= XCP_MAX_EVENT || gMdf.daqCount >= XCP_MAX_DAQ_COUNT) return 0;
+            events[gMdf.daqCount++] = gMdf.signals[j].event;
+        }
+    }
+    if (gMdf.daqCount == 0) return 0;
+
+    gMdf.daq = (tMdfDaq*)malloc(gMdf.daqCount * sizeof(tMdfDaq));
+    if (gMdf.daq == NULL) return 0;
+    memset(gMdf.daq, 0, gMdf.daqCount * sizeof(tMdfDaq));
+
+    // Layout, fill ODTs up to the DTO size
+    for (daq = 0; daq < gMdf.daqCount; daq++) {
+        l = &gMdf.daq[daq];
+        l->event = events[daq];
+        l->odtCount = 1;
+        for (j = 0; j < gMdf.signalCount; j++) {
+            s = &gMdf.signals[j];
+            if (s->event != l->event) continue;
+            n = mdfSignalSize(s);
+            odt = (uint16_t)(l->odtCount - 1);
+            cap = XCPTL_DTO_SIZE - XCP_DAQ_HDR_SIZE - (odt == 0 ? XCP_TIMESTAMP_SIZE : 0);
+            if (l->odtSize[odt] + n > cap || l->odtEntryCount[odt] == 0xFF) { // Next ODT
+                if (l->odtCount >= MDF_MAX_ODT) {
+                    printf("ERROR: too many MDF recorder signals for event %u!\n", l->event);
+                    return 0;
+                }
+                odt = l->odtCount++;
+                l->odtOffset[odt] = l->size;
+            }
+            s->daq = daq;
+            s->odt = odt;
+            s->recordOffset = l->size;
+            l->odtSize[odt] = (uint16_t)(l->odtSize[odt] + n);
+            l->odtEntryCount[odt]++;
+            l->size += n;
+        }
+        l->record = (uint8_t*)malloc(MDF_RECORD_ID_SIZE + 8 + l->size);
+        if (l->record == NULL) return 0;
+        *(uint16_t*)l->record = (uint16_t)(daq + 1);
+        l->nextOdt = MDF_ODT_NONE;
+        l->clock = gMdf.startClock;
+    }
+
+    // Create the DAQ lists in the protocol layer, ALLOC_DAQ, ALLOC_ODT, ALLOC_ODT_ENTRY, WRITE_DAQ sequence
+    XcpFreeDaq();
+    if (XcpAllocDaq(gMdf.daqCount) != 0) return 0;
+    for (daq = 0; daq < gMdf.daqCount; daq++) {
+        if (XcpAllocOdt(daq, (vuint8)gMdf.daq[daq].odtCount) != 0) return 0;
+    }
+    for (daq = 0; daq < gMdf.daqCount; daq++) {
+        for (odt = 0; odt < gMdf.daq[daq].odtCount; odt++) {
+            if (XcpAllocOdtEntry(daq, (vuint8)odt, gMdf.daq[daq].odtEntryCount[odt]) != 0) return 0;
+        }
+    }
+    for (daq = 0; daq < gMdf.daqCount; daq++) {
+        cur = -1;
+        for (j = 0; j < gMdf.signalCount; j++) {
+            s = &gMdf.signals[j];
+            if (s->event != gMdf.daq[daq].event) continue;
+            if (s->odt != cur) {
+                cur = s->odt;
+                if (XcpSetDaqPtr(daq, (vuint8)cur, 0) != 0) return 0;
+            }
+            if (XcpAddOdtEntry(s->addr, 0, (vuint8)mdfSignalSize(s)) != 0) return 0;
+        }
+        XcpSetDaqListMode(daq, gMdf.daq[daq].event, DAQ_FLAG_TIMESTAMP | DAQ_FLAG_SELECTED, 1);
+    }
+    return 1;
+}
+
+static void mdfFreeDaqLists() {
+
+    uint16_t daq;
+    if (gMdf.daq == NULL) return;
+    for (daq = 0; daq < gMdf.daqCount; daq++) free(gMdf.daq[daq].record);
+    free(gMdf.daq);
+    gMdf.daq = NULL;
+    gMdf.daqCount = 0;
+}
+
+
+//------------------------------------------------------------------------------
+// File
+
+// Append to the file, full blocks are written aligned
+static void mdfAppend(const void* data, uint32_t size) {
+
+    const uint8_t* p = (const uint8_t*)data;
+    uint32_t n;
+
+    gMdf.fileSize += size;
+    while (size > 0) {
+        n = XCP_MDF_BLOCK_SIZE - gMdf.blockLen;
+        if (n > size) n = size;
+        memcpy(&gMdf.block[gMdf.blockLen], p, n);
+        gMdf.blockLen += n;
+        p += n;
+        size -= n;
+        if (gMdf.blockLen == XCP_MDF_BLOCK_SIZE) {
+            if (!gMdf.error && write(gMdf.fd, gMdf.block, XCP_MDF_BLOCK_SIZE) != XCP_MDF_BLOCK_SIZE) {
+                printf("ERROR: MDF file write failed (errno=%d)!\n", errno);
+                gMdf.error = 1;
+            }
+            gMdf.blockLen = 0;
+        }
+    }
+}
+
+// Write to a file position, after the recording has been flushed
+static void mdfPatch(uint64_t pos, const void* data, uint32_t size) {
+
+    if (!gMdf.error && pwrite(gMdf.fd, data, size, (off_t)pos) != (ssize_t)size) {
+        printf("ERROR: MDF file write failed (errno=%d)!\n", errno);
+        gMdf.error = 1;
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Metadata
+
+// Append a block with zero links and data to the metadata, returns its file position
+static uint32_t mdfBlock(const char* id, uint32_t linkCount, uint32_t dataSize) {
+
+    uint32_t pos = gMdf.metaLen;
+    uint64_t length = sizeof(tMdfHeader) + 8 * linkCount + dataSize;
+    uint32_t size = (uint32_t)MDF_ALIGN8(length);
+    tMdfHeader* h;
+
+    if (gMdf.metaLen + size > gMdf.metaSize) {
+        gMdf.metaSize = 2 * gMdf.metaSize + size;
+        gMdf.meta = (uint8_t*)realloc(gMdf.meta, gMdf.metaSize);
+        if (gMdf.meta == NULL) {
+            printf("ERROR: out of memory!\n");
+            exit(1);
+        }
+    }
+    memset(&gMdf.meta[pos], 0, size);
+    h = (tMdfHeader*)&gMdf.meta[pos];
+    memcpy(h->id, id, 4);
+    h->length = length;
+    h->link_count = linkCount;
+    gMdf.metaLen += size;
+    return pos;
+}
+
+// ID block, unfinalized until the recording is stopped
+static void mdfId(tMdfId* id, int finalized) {
+
+    memset(id, 0, sizeof(tMdfId));
+    memcpy(id->file_id, finalized ? "MDF     " : "UnFinMF ", 8);
+    memcpy(id->format_id, "4.10    ", 8);
+    memcpy(id->program_id, "XCPlite ", 8);
+    id->version = 410;
+    id->unfin_flags = finalized ? 0 : (MDF_UNFIN_CG_CYCLE_COUNT | MDF_UNFIN_DT_LENGTH);
+}
+
+#define MDF_LINK(pos,i) (*(uint64_t*)&gMdf.meta[(pos) + sizeof(tMdfHeader) + 8 * (i)])
+#define MDF_DATA(type,pos,links) ((type*)&gMdf.meta[(pos) + sizeof(tMdfHeader) + 8 * (links)])
+
+// Text block, returns 0 for an empty string
+static uint32_t mdfText(const char* s) {
+
+    uint32_t pos;
+    if (s == NULL || *s == 0) return 0;
+    pos = mdfBlock("##TX", 0, (uint32_t)strlen(s) + 1);
+    strcpy((char*)MDF_DATA(char, pos, 0), s);
+    return pos;
+}
+
+static uint32_t mdfChannel(const char* name, uint8_t type, uint8_t syncType, uint8_t dataType, uint32_t byteOffset, uint32_t bitCount, const char* unit, const char* comment) {
+
+    uint32_t pos = mdfBlock("##CN", MDF_CN_LINKS, sizeof(tMdfCn));
+    uint32_t tx = mdfText(name);
+    uint32_t md = mdfText(unit);
+    uint32_t co = mdfText(comment);
+    tMdfCn* cn = MDF_DATA(tMdfCn, pos, MDF_CN_LINKS);
+
+    cn->type = type;
+    cn->sync_type = syncType;
+    cn->data_type = dataType;
+    cn->byte_offset = byteOffset;
+    cn->bit_count = bitCount;
+    MDF_LINK(pos, 2) = tx;
+    MDF_LINK(pos, 6) = md;
+    MDF_LINK(pos, 7) = co;
+    return pos;
+}
+
+// Build the ID, HD, DG, CG, CN, CC and TX blocks and the data block header
+static void mdfCreateMetadata() {
+
+    tMdfHd* hd;
+    tMdfCg* cg;
+    tMdfCc* cc;
+    tMdfSignal* s;
+    tMdfDaq* l;
+    struct timespec ts;
+    uint32_t hdPos, dgPos, cgPos, cnPos, ccPos, prevCg, prevCn;
+    uint32_t j;
+    uint16_t daq;
+
+    gMdf.metaLen = 0;
+    gMdf.metaSize = 64 * 1024;
+    gMdf.meta = (uint8_t*)malloc(gMdf.metaSize);
+    if (gMdf.meta == NULL) {
+        printf("ERROR: out of memory!\n");
+        exit(1);
+    }
+
+    mdfId((tMdfId*)gMdf.meta, 0);
+    gMdf.metaLen = sizeof(tMdfId);
+
+    // Header block
+    hdPos = mdfBlock("##HD", MDF_HD_LINKS, sizeof(tMdfHd));
+    clock_gettime(CLOCK_REALTIME, &ts);
+    hd = MDF_DATA(tMdfHd, hdPos, MDF_HD_LINKS);
+    hd->start_time_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+
+    // Unsorted data group, one channel group for each DAQ list
+    dgPos = mdfBlock("##DG", MDF_DG_LINKS, sizeof(tMdfDg));
+    MDF_DATA(tMdfDg, dgPos, MDF_DG_LINKS)->rec_id_size = MDF_RECORD_ID_SIZE;
+    MDF_LINK(hdPos, 0) = dgPos;
+
+    prevCg = 0;
+    for (daq = 0; daq < gMdf.daqCount; daq++) {
+        l = &gMdf.daq[daq];
+        cgPos = mdfBlock("##CG", MDF_CG_LINKS, sizeof(tMdfCg));
+        cg = MDF_DATA(tMdfCg, cgPos, MDF_CG_LINKS);
+        cg->record_id = daq + 1;
+        cg->data_bytes = 8 + l->size;
+        l->cgPos = cgPos;
+        if (prevCg == 0) MDF_LINK(dgPos, 1) = cgPos; else MDF_LINK(prevCg, 0) = cgPos;
+        prevCg = cgPos;
+#ifdef XCP_ENABLE_DAQ_EVENT_LIST
+        if (l->event < ApplXcpEventCount) MDF_LINK(cgPos, 2) = mdfText(ApplXcpEventList[l->event].name);
+#endif
+
+        // Master channel, time in s since start of recording
+        cnPos = mdfChannel("t", MDF_CN_MASTER, MDF_SYNC_TIME, MDF_DT_FLOAT_LE, 0, 64, "s", NULL);
+        MDF_LINK(cgPos, 1) = cnPos;
+        prevCn = cnPos;
+
+        for (j = 0; j < gMdf.signalCount; j++) {
+            s = &gMdf.signals[j];
+            if (s->event != l->event) continue;
+            cnPos = mdfChannel(s->name, MDF_CN_VALUE, MDF_SYNC_NONE, mdfSignalDataType(s), 8 + s->recordOffset, 8 * mdfSignalSize(s), s->unit, s->comment);
+            if (s->factor != 0.0 && (s->factor != 1.0 || s->offset != 0.0)) { // Linear conversion
+                ccPos = mdfBlock("##CC", MDF_CC_LINKS, sizeof(tMdfCc));
+                cc = MDF_DATA(tMdfCc, ccPos, MDF_CC_LINKS);
+                cc->type = MDF_CC_LINEAR;
+                cc->val_count = 2;
+                cc->val[0] = s->offset;
+                cc->val[1] = s->factor;
+                MDF_LINK(cnPos, 4) = ccPos;
+            }
+            MDF_LINK(prevCn, 0) = cnPos;
+            prevCn = cnPos;
+        }
+    }
+
+    // Data block, the length is updated when the recording is stopped
+    gMdf.dtPos = mdfBlock("##DT", 0, 0);
+    MDF_LINK(dgPos, 2) = gMdf.dtPos;
+}
+
+
+//------------------------------------------------------------------------------
+// Writer thread
+
+// Copy a DTO message into the record of its DAQ list, append the record to the file when complete
+static void mdfHandleDto(const uint8_t* d, uint16_t size) {
+
+    tMdfDaq* l;
+    uint16_t daq, odt, hs;
+    uint64_t clock;
+    double t;
+
+#if (XCP_DAQ_HDR_SIZE==4)
+    daq = *(const uint16_t*)&d[2];
+#else
+    daq = d[1];
+#endif
+    odt = (uint16_t)(d[0] & 0x7F);
+    hs = (uint16_t)(XCP_DAQ_HDR_SIZE + (odt == 0 ? XCP_TIMESTAMP_SIZE : 0));
+    if (daq >= gMdf.daqCount || odt >= gMdf.daq[daq].odtCount || size != hs + gMdf.daq[daq].odtSize[odt]) {
+        gMdf.invalidCount++;
+        return;
+    }
+    l = &gMdf.daq[daq];
+
+    if (odt == 0) { // First ODT with timestamp, start a new record
+        if (l->nextOdt != MDF_ODT_NONE) gMdf.droppedCount++; // Previous record incomplete
+#if (XCP_TIMESTAMP_SIZE==8)
+        clock = *(const uint64_t*)&d[XCP_DAQ_HDR_SIZE];
+#else
+        clock = l->clock + (int64_t)(int32_t)(*(const uint32_t*)&d[XCP_DAQ_HDR_SIZE] - (uint32_t)l->clock); // Extend to 64 bit
+#endif
+        l->clock = clock;
+        t = (double)(int64_t)(clock - gMdf.startClock) / (CLOCK_TICKS_PER_MS * 1000.0);
+        memcpy(&l->record[MDF_RECORD_ID_SIZE], &t, 8);
+        l->nextOdt = 0;
+    }
+    else if (odt != l->nextOdt) { // ODT missing, drop the record
+        if (l->nextOdt != MDF_ODT_NONE) gMdf.droppedCount++;
+        l->nextOdt = MDF_ODT_NONE;
+        return;
+    }
+
+    memcpy(&l->record[MDF_RECORD_ID_SIZE + 8 + l->odtOffset[odt]], &d[hs], size - hs);
+    if (++l->nextOdt == l->odtCount) {
+        mdfAppend(l->record, MDF_RECORD_ID_SIZE + 8 + l->size);
+        l->cycleCount++;
+        l->nextOdt = MDF_ODT_NONE;
+    }
+}
+
+// Handle all commited DTO messages in the ring
+// Returns the number of DTO messages handled
+static uint32_t mdfHandleRing() {
+
+    tMdfSlot* s;
+    uint64_t rp = gMdf.rp;
+    uint32_t n = 0;
+
+    while (rp < atomicLoad64(&gMdf.wp)) {
+        s = MDF_SLOT(rp);
+        if (atomicLoad32(&s->state) == 0) break; // Not commited yet
+        mdfHandleDto(s->data, s->size);
+        atomicStore32(&s->state, 0);
+        atomicStore64(&gMdf.rp, ++rp);
+        n++;
+    }
+    return n;
+}
+
+static void* mdfWriterThread(void* par) {
+
+    (void)par;
+    while (atomicLoad32(&gMdf.running)) {
+        if (mdfHandleRing() == 0) sleepMs(XCP_MDF_POLL_CYCLE_MS); // Polling, XcpEvent does not signal
+    }
+    return NULL;
+}
+
+
+//------------------------------------------------------------------------------
+// Recorder
+
+static int mdfStart_(const char* filename) {
+
+    if (gMdf.active) return 0;
+    if (XcpIsConnected() || XcpIsDaqRunning()) {
+        printf("ERROR: MDF recorder can not be started, DAQ is used by the XCP master!\n");
+        return 0;
+    }
+    if (gMdf.signalCount == 0) {
+        printf("ERROR: no signals for the MDF recorder!\n");
+        return 0;
+    }
+
+    if (gMdf.slots == NULL) {
+        gMdf.slots = (tMdfSlot*)malloc(XCP_MDF_SLOT_COUNT * sizeof(tMdfSlot));
+        if (gMdf.slots == NULL) {
+            printf("ERROR: out of memory!\n");
+            return 0;
+        }
+    }
+    if (gMdf.block == NULL && posix_memalign((void**)&gMdf.block, MDF_BLOCK_ALIGNMENT, XCP_MDF_BLOCK_SIZE) != 0) {
+        gMdf.block = NULL;
+        printf("ERROR: out of memory!\n");
+        return 0;
+    }
+
+    // Open the file, O_DIRECT is not supported by all file systems
+    gMdf.direct = 1;
+    gMdf.fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if (gMdf.fd < 0 && errno == EINVAL) {
+        gMdf.direct = 0;
+        gMdf.fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (gMdf.fd < 0) {
+        printf("ERROR: cannot create MDF file %s (errno=%d)!\n", filename, errno);
+        return 0;
+    }
+
+    gMdf.startClock = clockGet64();
+    gMdf.blockLen = 0;
+    gMdf.fileSize = 0;
+    gMdf.error = 0;
+    gMdf.droppedCount = gMdf.invalidCount = 0;
+    gMdf.wp = gMdf.rp = 0;
+    memset(gMdf.slots, 0, XCP_MDF_SLOT_COUNT * sizeof(tMdfSlot));
+    if (!mdfCreateDaqLists()) {
+        printf("ERROR: cannot create DAQ lists for the MDF recorder!\n");
+        XcpFreeDaq();
+        mdfFreeDaqLists();
+        close(gMdf.fd);
+        return 0;
+    }
+    mdfCreateMetadata();
+    mdfAppend(gMdf.meta, gMdf.metaLen);
+    free(gMdf.meta);
+    gMdf.meta = NULL;
+
+    atomicStore32(&gMdf.active, 1);
+    atomicStore32(&gMdf.running, 1);
+    create_thread(&gMdf.thread, mdfWriterThread);
+    XcpStartAllSelectedDaq();
+    printf("Start MDF recorder %s (%u signals, %u DAQ lists%s)\n", filename, gMdf.signalCount, gMdf.daqCount, gMdf.direct ? ", O_DIRECT" : "");
+    return 1;
+}
+
+// Start recording all registered signals to filename
+// DAQ lists are created in the protocol layer, an XCP master must not be connected, CONNECT is refused while recording
+int mdfStart(const char* filename) {
+
+    int ok;
+    mutexLock(&gMdfMutex);
+    ok = mdfStart_(filename);
+    mutexUnlock(&gMdfMutex);
+    return ok;
+}
+
+// Stop recording and finalize the MDF file
+void mdfStop() {
+
+    uint64_t pos, length;
+    uint16_t daq;
+    uint32_t i;
+    char comment[128];
+    tMdfHeader* h;
+    tMdfId id;
+    uint8_t tx[sizeof(tMdfHeader) + sizeof(comment)];
+
+    mutexLock(&gMdfMutex);
+    if (!gMdf.active) {
+        mutexUnlock(&gMdfMutex);
+        return;
+    }
+
+    // Stop DAQ, the writer thread and handle the rest of the ring
+    XcpStopAllDaq();
+    atomicStore32(&gMdf.running, 0);
+    pthread_join(gMdf.thread, NULL);
+    atomicStore32(&gMdf.active, 0);
+    for (i = 0; i < 100 && atomicLoad64(&gMdf.wp) != gMdf.rp; i++) { // Events may still commit
+        mdfHandleRing();
+        sleepMs(1);
+    }
+    mdfHandleRing();
+
+    // Write the last incomplete block unaligned
+    if (gMdf.direct) fcntl(gMdf.fd, F_SETFL, fcntl(gMdf.fd, F_GETFL) & ~O_DIRECT);
+    if (gMdf.blockLen > 0 && !gMdf.error && write(gMdf.fd, gMdf.block, gMdf.blockLen) != (ssize_t)gMdf.blockLen) {
+        printf("ERROR: MDF file write failed (errno=%d)!\n", errno);
+        gMdf.error = 1;
+    }
+    gMdf.blockLen = 0;
+
+    // Finalize, data block length, cycle counters, comment with the number of dropped samples and ID block
+    length = gMdf.fileSize - gMdf.dtPos;
+    mdfPatch(gMdf.dtPos + 8, &length, 8);
+    for (daq = 0; daq < gMdf.daqCount; daq++) {
+        mdfPatch(gMdf.daq[daq].cgPos + sizeof(tMdfHeader) + 8 * MDF_CG_LINKS + 8, &gMdf.daq[daq].cycleCount, 8);
+    }
+    snprintf(comment, sizeof(comment), "XCPlite MDF recorder, dropped samples: %u", mdfGetDroppedCount());
+    memset(tx, 0, sizeof(tx));
+    h = (tMdfHeader*)tx;
+    memcpy(h->id, "##TX", 4);
+    h->length = sizeof(tMdfHeader) + strlen(comment) + 1;
+    strcpy((char*)&tx[sizeof(tMdfHeader)], comment);
+    pos = MDF_ALIGN8(gMdf.fileSize);
+    mdfPatch(pos, tx, (uint32_t)MDF_ALIGN8(h->length));
+    mdfPatch(sizeof(tMdfId) + sizeof(tMdfHeader) + 8 * 5, &pos, 8); // hd_md_comment
+    mdfId(&id, 1);
+    mdfPatch(0, &id, sizeof(id));
+    close(gMdf.fd);
+
+    printf("Stop MDF recorder (%llu bytes, dropped samples=%u)\n", (unsigned long long)gMdf.fileSize, mdfGetDroppedCount());
+    mdfFreeDaqLists();
+    mutexUnlock(&gMdfMutex);
+}
+
+// Called by the protocol layer on CONNECT, after the session status has been set to connected
+// A XCP master connecting while recording would free the DAQ lists of the recorder and its DTOs would be routed into the MDF file
+// Returns 0, if CONNECT must be refused
+int mdfConnect() {
+
+    int ok;
+    mutexLock(&gMdfMutex);
+    ok = !atomicLoad32(&gMdf.active);
+    mutexUnlock(&gMdfMutex);
+    if (!ok) printf("WARNING: XCP master CONNECT refused, MDF recorder is active!\n");
+    return ok;
+}
+
+int mdfIsRecording() {
+
+    return atomicLoad32(&gMdf.active) != 0;
+}
+
+// Number of samples lost, events skipped on ring overflow and incomplete or unexpected records
+uint32_t mdfGetDroppedCount() {
+
+    return XcpGetDaqOverflowCount() + gMdf.droppedCount + gMdf.invalidCount;
+}
+
+
+//------------------------------------------------------------------------------
+// DTO buffer interface for the protocol layer
+// Thread safe and lock free
+
+unsigned char* mdfGetDtoBuffer(void** par, unsigned int size) {
+
+    tMdfSlot* s;
+    uint64_t wp;
+
+    if (!atomicLoad32(&gMdf.active)) return ApplXcpTlGetDtoBuffer(par, size);
+    if (size > XCPTL_DTO_SIZE) return NULL;
+
+    do {
+        wp = atomicLoad64(&gMdf.wp);
+        if (wp - atomicLoad64(&gMdf.rp) >= XCP_MDF_SLOT_COUNT) return NULL; // Overflow
+    } while (!atomicCas64(&gMdf.wp, wp, wp + 1));
+
+    s = MDF_SLOT(wp);
+    s->size = (uint16_t)size;
+    *((tMdfSlot**)par) = s;
+    return &s->data[0];
+}
+
+void mdfCommitDtoBuffer(void* par) {
+
+    if (MDF_IS_SLOT(par)) {
+        atomicStore32(&((tMdfSlot*)par)->state, 1);
+    }
+    else {
+        ApplXcpTlCommitDtoBuffer(par);
+    }
+}
+
+int mdfGetDtoBuffers(void** par, unsigned int count, const uint16_t* sizes, unsigned char** data) {
+
+    tMdfSlot* s;
+    uint64_t wp;
+    unsigned int i;
+
+    if (!atomicLoad32(&gMdf.active)) return ApplXcpTlGetDtoBuffers(par, count, sizes, data);
+    for (i = 0; i < count; i++) if (sizes[i] > XCPTL_DTO_SIZE) return 0;
+
+    do {
+        wp = atomicLoad64(&gMdf.wp);
+        if (wp + count - atomicLoad64(&gMdf.rp) > XCP_MDF_SLOT_COUNT) return 0; // Overflow
+    } while (!atomicCas64(&gMdf.wp, wp, wp + count));
+
+    for (i = 0; i < count; i++) {
+        s = MDF_SLOT(wp + i);
+        s->size = sizes[i];
+        data[i] = &s->data[0];
+    }
+    *((tMdfSlot**)par) = MDF_SLOT(wp); // Handle is the first slot
+    return 1;
+}
+
+void mdfCommitDtoBuffers(void* par, unsigned int count, unsigned int size) {
+
+    uint64_t first;
+    unsigned int i;
+
+    if (MDF_IS_SLOT(par)) {
+        first = (uint64_t)((tMdfSlot*)par - &gMdf.slots[0]);
+        for (i = 0; i < count; i++) atomicStore32(&MDF_SLOT(first + i)->state, 1);
+    }
+    else {
+        ApplXcpTlCommitDtoBuffers(par, count, size);
+    }
+}
+
+#endif
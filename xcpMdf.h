@@ -0,0 +1,50 @@
+/* xcpMdf.h */
+
+/* Copyright(c) Vector Informatik GmbH.All rights reserved.
+   Licensed under the MIT license.See LICENSE file in the project root for details. */
+
+#ifndef __XCPMDF_H__
+#define __XCPMDF_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef _LINUX // Linux only, O_DIRECT file writes
+    #undef XCP_ENABLE_MDF_RECORDER
+#endif
+
+#ifdef XCP_ENABLE_MDF_RECORDER
+
+// DTO message slot in the ring between XcpEvent and the writer thread
+typedef struct {
+    volatile uint32_t state; // 0 = free, 1 = commited
+    uint16_t size; // Size of the DTO message
+    uint16_t res;
+    uint8_t data[(XCPTL_DTO_SIZE + 7) & ~7];
+} tMdfSlot;
+
+// Signals, created by the A2L generator or by the application
+extern int mdfCreateSignal(const char* instanceName, const char* name, int type, uint32_t addr, uint16_t event, double factor, double offset, const char* unit, const char* comment);
+extern void mdfClearSignals();
+
+// Recorder
+extern int mdfStart(const char* filename);
+extern void mdfStop();
+extern int mdfIsRecording();
+extern uint32_t mdfGetDroppedCount();
+extern int mdfConnect();
+
+// Protocol layer DTO buffer interface
+extern unsigned char* mdfGetDtoBuffer(void** par, unsigned int size);
+extern void mdfCommitDtoBuffer(void* par);
+extern int mdfGetDtoBuffers(void** par, unsigned int count, const uint16_t* sizes, unsigned char** data);
+extern void mdfCommitDtoBuffers(void* par, unsigned int count, unsigned int size);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
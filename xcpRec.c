@@ -0,0 +1,433 @@
+/*----------------------------------------------------------------------------
+| File:
+|   xcpRec.c
+|
+| Description:
+|   DAQ pre-trigger recorder
+|   Records the DTO messages of XcpEvent into a ring buffer, the oldest are dropped
+|   On trigger, the recorded history is transmitted, followed by the live DTO messages
+|   Placed between the XCP protocol layer and the transport layer
+|
+| Copyright (c) Vector Informatik GmbH. All rights reserved.
+| Licensed under the MIT license. See LICENSE file in the project root for details.
+|
+ ----------------------------------------------------------------------------*/
+
+#include "configuration.h"
+#include "xcpAppl.h"
+
+#ifdef XCP_ENABLE_DAQ_RECORDER
+
+#define REC_ALIGNMENT 8 // Record alignment in the ring buffer
+#define REC_ALIGN(n) (((n) + (REC_ALIGNMENT-1)) & ~(uint32_t)(REC_ALIGNMENT-1))
+#define REC_FLUSH_COUNT 64 // Maximum number of records moved to the transport layer while the lock is held
+#define REC_NONE 0xFFFFFFFFFFFFFFFFULL // No position
+
+static struct {
+
+    uint8_t* buf; // Ring buffer
+    uint32_t size; // Ring buffer size
+    volatile uint32_t state; // REC_STATE_xxx, changed with mutex locked
+    uint64_t depth; // Pre-trigger depth in clock ticks, 0 = unlimited
+
+    // Positions, number of bytes reserved and read
+    // Events reserve records lock free, they move rp only to drop the oldest records while recording
+    // Positions are never reset, a record header from before a reset must not become valid again
+    // Control and the transmission of the history are protected by mutex
+    volatile uint64_t wp;
+    volatile uint64_t rp;
+    MUTEX mutex;
+
+    // Events in the ring buffer
+    volatile uint32_t reserving; // Events reserving records, they may drop records while recording
+    volatile uint32_t pending; // Records reserved and not commited yet, including events reserving
+
+    volatile uint32_t overflowCount; // DTO messages not recorded, because the ring buffer was full of uncommited records or flushing
+
+} gRec;
+
+volatile uint8_t gXcpRecTrigger = 0;
+
+// Record at a position
+#define REC_RECORD(pos) ((tRecRecord*)&gRec.buf[(pos) % gRec.size])
+
+// Check if a transport layer buffer parameter is a record in the ring buffer
+#define REC_IS_RECORD(p) (gRec.buf != NULL && (uint8_t*)(p) >= gRec.buf && (uint8_t*)(p) < gRec.buf + gRec.size)
+
+
+int recInit(uint32_t size) {
+
+    size = REC_ALIGN(size);
+    memset(&gRec, 0, sizeof(gRec));
+    gRec.buf = (uint8_t*)malloc(size + sizeof(tRecRecord)); // A padding record header at the end may exceed the size
+    if (gRec.buf == NULL) {
+        printf("ERROR: cannot allocate DAQ recorder buffer (size=%u)!\n", size);
+        return 0;
+    }
+    gRec.size = size;
+    gRec.depth = (uint64_t)XCP_REC_DEPTH_MS * CLOCK_TICKS_PER_MS;
+    gRec.state = REC_STATE_OFF;
+    mutexInit(&gRec.mutex, 0, 1000);
+    printf("Init DAQ recorder (size=%u)\n", size);
+    return 1;
+}
+
+void recShutdown() {
+
+    if (gRec.buf == NULL) return;
+    recStop();
+    mutexDestroy(&gRec.mutex);
+    free(gRec.buf);
+    gRec.buf = NULL;
+}
+
+uint32_t recGetState() {
+
+    return atomicLoad32(&gRec.state);
+}
+
+
+//------------------------------------------------------------------------------
+// Ring buffer
+
+// Get the record at position pos and its state
+// Returns REC_RECORD_RESERVED, if the record is still reserved by an event and its header may not be written yet
+static uint32_t recGetRecord(uint64_t pos, tRecRecord** pr) {
+
+    tRecRecord* r = REC_RECORD(pos);
+    *pr = r;
+    return atomicLoad64(&r->pos) == pos ? atomicLoad32(&r->state) : REC_RECORD_RESERVED;
+}
+
+// Drop the oldest records from rp up to position end, while recording
+// Returns 0, if the oldest record is still written by an event
+static int recDrop(uint64_t rp, uint64_t end) {
+
+    tRecRecord* r;
+    uint64_t p = rp;
+
+    while (p < end && recGetRecord(p, &r) != REC_RECORD_RESERVED && r->total >= sizeof(tRecRecord)) p += r->total;
+    if (p == rp) return atomicLoad64(&gRec.rp) != rp; // Retry, if dropped by another event meanwhile
+    atomicCas64(&gRec.rp, rp, p); // Fails, if dropped by another event meanwhile, the records read may be outdated then
+    return 1;
+}
+
+// Reserve total bytes for consecutive records, lock free
+// Returns the position of the first record or REC_NONE, if there is no space without dropping history which is still needed
+static uint64_t recReserve(uint32_t total) {
+
+    tRecRecord* r;
+    uint64_t wp, rp;
+    uint32_t pos, pad;
+
+    if (total > gRec.size) return REC_NONE;
+    for (;;) {
+        wp = atomicLoad64(&gRec.wp);
+        pos = (uint32_t)(wp % gRec.size);
+        pad = (pos + total > gRec.size) ? gRec.size - pos : 0; // Records must not wrap around
+        rp = atomicLoad64(&gRec.rp);
+        if (rp > wp) continue; // wp outdated
+        if (wp + pad + total - rp > gRec.size) { // Make room, drop the oldest records
+            if (atomicLoad32(&gRec.state) != REC_STATE_RECORDING) return REC_NONE; // Never drop history which is not transmitted yet
+            if (!recDrop(rp, wp + pad + total - gRec.size)) return REC_NONE;
+            continue;
+        }
+        if (atomicCas64(&gRec.wp, wp, wp + pad + total)) break;
+    }
+
+    // Padding at the end of the ring buffer
+    if (pad) {
+        r = REC_RECORD(wp);
+        r->total = pad;
+        r->state = REC_RECORD_PADDING;
+        atomicStore64(&r->pos, wp);
+    }
+    return wp + pad;
+}
+
+// Write the header of a reserved record
+static tRecRecord* recInitRecord(uint64_t pos, unsigned int size, uint64_t time) {
+
+    tRecRecord* r = REC_RECORD(pos);
+    r->total = REC_ALIGN((uint32_t)sizeof(tRecRecord) + size);
+    r->state = REC_RECORD_RESERVED;
+    r->time = time;
+    r->size = size;
+    atomicStore64(&r->pos, pos); // Publish the header
+    return r;
+}
+
+// Drop the oldest records until the first record of a DTO message with ODT 0, mutex must be locked and events must not drop records
+// The XCP master needs the first ODT of a DAQ list to decode the following ones
+static void recSkipToOdt0() {
+
+    tRecRecord* r;
+    uint32_t state;
+    while (gRec.rp < atomicLoad64(&gRec.wp)) {
+        state = recGetRecord(gRec.rp, &r);
+        if (state == REC_RECORD_RESERVED) break;
+        if (state == REC_RECORD_COMMITED && (((uint8_t*)(r + 1))[0] & 0x7F) == 0) break;
+        atomicStore64(&gRec.rp, gRec.rp + r->total);
+    }
+}
+
+// Move up to max commited records from the ring buffer to the transport layer, mutex must be locked and events must not drop records
+// Returns the number of DTO messages moved
+static int recTransmit(int max) {
+
+    tRecRecord* r;
+    unsigned char* d;
+    void* p;
+    uint32_t state;
+    int n = 0;
+
+    while (n < max && gRec.rp < atomicLoad64(&gRec.wp)) {
+        state = recGetRecord(gRec.rp, &r);
+        if (state == REC_RECORD_RESERVED) break; // Still written by an event
+        if (state == REC_RECORD_PADDING) {
+            atomicStore64(&gRec.rp, gRec.rp + r->total);
+            continue;
+        }
+        d = ApplXcpTlGetDtoBuffer(&p, r->size);
+        if (d == NULL) break; // Transmit queue full, continue in the next cycle
+        memcpy(d, r + 1, r->size);
+        ApplXcpTlCommitDtoBuffer(p);
+        atomicStore64(&gRec.rp, gRec.rp + r->total);
+        n++;
+    }
+    return n;
+}
+
+// Stop reservations of events in the ring buffer and wait until all reserved records are commited, mutex must be locked
+// DTO messages are dropped until the state is changed again
+static void recWaitPending() {
+
+    atomicStore32(&gRec.state, REC_STATE_RESET);
+    while (atomicLoad32(&gRec.pending) != 0) sleepNs(1000);
+}
+
+
+//------------------------------------------------------------------------------
+// Control
+
+// Start recording, DTO messages are not transmitted anymore until trigger
+// depthMs is the pre-trigger depth in ms, 0 = limited by the ring buffer size only
+// Returns 0, if the recorder is not initialized or the recorded history is still transmitted
+int recArm(uint32_t depthMs) {
+
+    if (gRec.buf == NULL) return 0;
+    mutexLock(&gRec.mutex);
+    if (gRec.state == REC_STATE_FLUSHING) {
+        mutexUnlock(&gRec.mutex);
+        return 0;
+    }
+    gRec.depth = (uint64_t)depthMs * CLOCK_TICKS_PER_MS;
+    if (gRec.state == REC_STATE_OFF) { // No events in the ring buffer
+        atomicStore64(&gRec.rp, gRec.wp); // Discard
+        atomicStore32(&gRec.overflowCount, 0);
+    }
+    gXcpRecTrigger = 0;
+    atomicStore32(&gRec.state, REC_STATE_RECORDING);
+    mutexUnlock(&gRec.mutex);
+    if (gDebugLevel >= 1) printf("DAQ recorder armed (depth=%ums)\n", depthMs);
+    return 1;
+}
+
+// Freeze the pre-trigger history and start transmitting it
+// Returns 0, if not recording
+int recTrigger() {
+
+    tRecRecord* r;
+    uint32_t state;
+    uint64_t t;
+
+    mutexLock(&gRec.mutex);
+    if (gRec.state != REC_STATE_RECORDING) {
+        mutexUnlock(&gRec.mutex);
+        return 0;
+    }
+
+    // Events do not drop records anymore, wait for those which checked the state before
+    atomicStore32(&gRec.state, REC_STATE_FLUSHING);
+    while (atomicLoad32(&gRec.reserving) != 0) {} // Short, reservations do not wait
+
+    // Limit the history to the pre-trigger depth
+    if (gRec.depth > 0) {
+        t = clockGet64();
+        while (gRec.rp < atomicLoad64(&gRec.wp)) {
+            state = recGetRecord(gRec.rp, &r);
+            if (state == REC_RECORD_RESERVED) break;
+            if (state == REC_RECORD_COMMITED && t - r->time <= gRec.depth) break;
+            atomicStore64(&gRec.rp, gRec.rp + r->total);
+        }
+    }
+    recSkipToOdt0();
+
+    mutexUnlock(&gRec.mutex);
+    if (gDebugLevel >= 1) printf("DAQ recorder triggered (history=%u bytes, overflows=%u)\n", (uint32_t)(gRec.wp - gRec.rp), gRec.overflowCount);
+    return 1;
+}
+
+// Stop recording and discard the history, DTO messages are transmitted again
+void recStop() {
+
+    if (gRec.buf == NULL) return;
+    mutexLock(&gRec.mutex);
+    if (gRec.state != REC_STATE_OFF) {
+        recWaitPending();
+        atomicStore64(&gRec.rp, gRec.wp); // Discard
+        atomicStore32(&gRec.state, REC_STATE_OFF);
+    }
+    mutexUnlock(&gRec.mutex);
+}
+
+// Check the trigger parameter and move recorded DTO messages to the transport layer
+// Called cyclically by the transmit thread
+// Returns the number of DTO messages moved
+int recHandleTransmit() {
+
+    int n = 0;
+    int i;
+
+    if (gXcpRecTrigger) {
+        gXcpRecTrigger = 0;
+        recTrigger();
+    }
+
+    while (atomicLoad32(&gRec.state) == REC_STATE_FLUSHING) {
+
+        // Release the lock periodically, events continue to append to the ring buffer while flushing
+        mutexLock(&gRec.mutex);
+        if (gRec.state != REC_STATE_FLUSHING) { // Stopped meanwhile
+            mutexUnlock(&gRec.mutex);
+            break;
+        }
+        i = recTransmit(REC_FLUSH_COUNT);
+        n += i;
+        if (gRec.rp == atomicLoad64(&gRec.wp)) { // History transmitted, continue with live data
+            recWaitPending(); // Transmit the records appended meanwhile first, to keep the order of the DTO messages
+            while (recTransmit(REC_FLUSH_COUNT) > 0) {}
+            if (gRec.rp != gRec.wp) printf("WARNING: DAQ recorder history incomplete, transmit queue full!\n");
+            atomicStore64(&gRec.rp, gRec.wp); // Discard
+            atomicStore32(&gRec.state, REC_STATE_OFF);
+            if (gDebugLevel >= 1) printf("DAQ recorder history transmitted\n");
+        }
+        mutexUnlock(&gRec.mutex);
+        if (i < REC_FLUSH_COUNT) break;
+    }
+    return n;
+}
+
+
+//------------------------------------------------------------------------------
+// DTO buffer interface for the protocol layer
+// Thread safe and lock free for the events
+
+// Announce an event in the ring buffer, before the state is checked
+// Returns 0, if the recorder is off and the DTO messages are passed to the transport layer
+static int recEnter(unsigned int count) {
+
+    atomicAdd32(&gRec.pending, count);
+    atomicAdd32(&gRec.reserving, 1);
+    if (atomicLoad32(&gRec.state) == REC_STATE_OFF) { // Stopped or flushed in the meantime
+        atomicAdd32(&gRec.reserving, -1);
+        atomicAdd32(&gRec.pending, -(int)count);
+        return 0;
+    }
+    return 1;
+}
+
+// Reserve total bytes for count records announced by recEnter
+static uint64_t recReserveRecords(unsigned int count, uint32_t total) {
+
+    uint32_t state = atomicLoad32(&gRec.state); // Stopped, reset or rearmed in the meantime
+    uint64_t pos = (state == REC_STATE_RECORDING || state == REC_STATE_FLUSHING) ? recReserve(total) : REC_NONE;
+    atomicAdd32(&gRec.reserving, -1);
+    if (pos == REC_NONE) {
+        atomicAdd32(&gRec.overflowCount, 1);
+        atomicAdd32(&gRec.pending, -(int)count);
+    }
+    return pos;
+}
+
+unsigned char* recGetDtoBuffer(void** par, unsigned int size) {
+
+    tRecRecord* r;
+    uint64_t pos;
+
+    if (atomicLoad32(&gRec.state) == REC_STATE_OFF || !recEnter(1)) return ApplXcpTlGetDtoBuffer(par, size);
+    pos = recReserveRecords(1, REC_ALIGN((uint32_t)sizeof(tRecRecord) + size));
+    if (pos == REC_NONE) return NULL;
+    r = recInitRecord(pos, size, clockGet64());
+    *par = r;
+    return (unsigned char*)(r + 1);
+}
+
+void recCommitDtoBuffer(void* par) {
+
+    if (REC_IS_RECORD(par)) {
+        atomicStore32(&((tRecRecord*)par)->state, REC_RECORD_COMMITED);
+        atomicAdd32(&gRec.pending, -1);
+    }
+    else {
+        ApplXcpTlCommitDtoBuffer(par);
+    }
+}
+
+// The DTO messages of an event are recorded as consecutive records with a single reservation
+int recGetDtoBuffers(void** par, unsigned int count, const uint16_t* sizes, unsigned char** data) {
+
+    tRecRecord* r;
+    uint64_t pos, time;
+    uint32_t total = 0;
+    unsigned int i;
+
+    if (atomicLoad32(&gRec.state) == REC_STATE_OFF || !recEnter(count)) return ApplXcpTlGetDtoBuffers(par, count, sizes, data);
+    for (i = 0; i < count; i++) total += REC_ALIGN((uint32_t)sizeof(tRecRecord) + sizes[i]);
+    pos = recReserveRecords(count, total);
+    if (pos == REC_NONE) return 0; // The protocol layer falls back to recGetDtoBuffer
+    time = clockGet64();
+    for (i = 0; i < count; i++) {
+        r = recInitRecord(pos, sizes[i], time);
+        if (i == 0) *par = r; // Handle is the first record
+        data[i] = (unsigned char*)(r + 1);
+        pos += r->total;
+    }
+    return 1;
+}
+
+void recCommitDtoBuffers(void* par, unsigned int count, unsigned int size) {
+
+    tRecRecord* r = (tRecRecord*)par;
+    tRecRecord* next;
+    unsigned int i;
+
+    if (REC_IS_RECORD(par)) {
+        for (i = 0; i < count; i++) {
+            next = (tRecRecord*)((uint8_t*)r + r->total); // Records of an event do not wrap around
+            atomicStore32(&r->state, REC_RECORD_COMMITED); // May be dropped from now on
+            r = next;
+        }
+        atomicAdd32(&gRec.pending, -(int)count);
+    }
+    else {
+        ApplXcpTlCommitDtoBuffers(par, count, size);
+    }
+}
+
+// DAQ start, recorded history of a previous measurement is invalid
+void recDaqStart() {
+
+    if (gRec.buf != NULL) {
+        mutexLock(&gRec.mutex);
+        if (gRec.state != REC_STATE_OFF) {
+            recWaitPending();
+            atomicStore64(&gRec.rp, gRec.wp); // Discard
+            atomicStore32(&gRec.state, REC_STATE_RECORDING);
+        }
+        mutexUnlock(&gRec.mutex);
+    }
+    ApplXcpTlDaqStart();
+}
+
+#endif
@@ -0,0 +1,61 @@
+/* xcpRec.h */
+
+/* Copyright(c) Vector Informatik GmbH.All rights reserved.
+   Licensed under the MIT license.See LICENSE file in the project root for details. */
+
+#ifndef __XCPREC_H__
+#define __XCPREC_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef XCP_ENABLE_DAQ_RECORDER
+
+// Recorder states
+#define REC_STATE_OFF       0 // DTO messages are passed to the transport layer
+#define REC_STATE_RECORDING 1 // DTO messages are recorded into the ring buffer, the oldest are dropped
+#define REC_STATE_FLUSHING  2 // Triggered, the recorded history is transmitted, new DTO messages are appended until the ring buffer is empty
+#define REC_STATE_RESET     3 // Waiting for the reserved records to be commited, before the ring buffer is reset, new DTO messages are dropped
+
+// Record states
+#define REC_RECORD_RESERVED 0 // DTO message data is written
+#define REC_RECORD_COMMITED 1 // DTO message data is complete
+#define REC_RECORD_PADDING  2 // Unused space at the end of the ring buffer, only total and state are valid
+
+// Record header in the ring buffer, followed by the DTO message data
+typedef struct {
+    uint32_t total; // Size of the record in the ring buffer including header and alignment
+    volatile uint32_t state; // REC_RECORD_xxx
+    volatile uint64_t pos; // Position of the record, written last, the header is valid if it matches
+    uint64_t time; // Clock at reservation
+    uint32_t size; // Size of the DTO message
+    uint32_t res;
+} tRecRecord;
+
+// Recorder
+extern int recInit(uint32_t size);
+extern void recShutdown();
+extern int recArm(uint32_t depthMs);
+extern int recTrigger();
+extern void recStop();
+extern uint32_t recGetState();
+extern int recHandleTransmit();
+
+// Trigger flag, may be written by the XCP master as a calibration parameter
+extern volatile uint8_t gXcpRecTrigger;
+
+// Protocol layer DTO buffer interface
+extern unsigned char* recGetDtoBuffer(void** par, unsigned int size);
+extern void recCommitDtoBuffer(void* par);
+extern int recGetDtoBuffers(void** par, unsigned int count, const uint16_t* sizes, unsigned char** data);
+extern void recCommitDtoBuffers(void* par, unsigned int count, unsigned int size);
+extern void recDaqStart();
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -25,6 +25,12 @@ tXcpThread gDAQThreadHandle;
 volatile int gXcpSlaveDAQThreadRunning = 0;
 tXcpThread gCMDThreadHandle;
 volatile int gXcpSlaveCMDThreadRunning = 0;
+#ifdef XCP_ENABLE_CMD_QUEUE
+tXcpThread gCMDWorkerThreadHandle;
+#endif
+#ifdef XCP_ENABLE_CAL_STORE
+tXcpThread gCalStoreThreadHandle;
+#endif
 
 // XCP slave init
 int xcpSlaveInit() {
@@ -60,31 +66,97 @@ int xcpSlaveInit() {
 #endif
 #ifdef XCP_ENABLE_CHECKSUM
     printf("CHECKSUM,");
+#endif
+#ifdef XCP_ENABLE_DAQ_RECORDER
+    printf("DAQ_RECORDER,");
+#endif
+#ifdef XCP_ENABLE_MDF_RECORDER
+    printf("MDF_RECORDER,");
+#endif
+#ifdef XCP_ENABLE_CMD_QUEUE
+    printf("CMD_QUEUE,");
+#endif
+#ifdef XCP_ENABLE_CAL_STORE
+    printf("CAL_STORE,");
 #endif
     printf(")\n");
 
     // Initialize XCP protocol layer
     XcpInit();
 
+#ifdef XCP_ENABLE_DAQ_RECORDER
+    // Initialize DAQ pre-trigger recorder
+    if (!recInit(XCP_REC_BUFFER_SIZE)) return 0;
+#endif
+
+#ifdef XCP_ENABLE_CMD_QUEUE
+    // Create thread for long running and queued commands
+    create_thread(&gCMDWorkerThreadHandle, xcpSlaveCMDWorkerThread);
+#endif
+
+#ifdef XCP_ENABLE_CAL_STORE
+    // Create thread for writing the calibration store file
+    create_thread(&gCalStoreThreadHandle, xcpSlaveCalStoreThread);
+#endif
+
     // Initialize XCP transport layer
+#ifdef XCPTL_ENABLE_SHM
+    r = shmTlInit();
+    if (!r) return 0;
+
+    // Create thread for command handling, DTO packets are read directly from shared memory
+    create_thread(&gCMDThreadHandle, xcpSlaveCMDThread);
+    sleepMs(200UL);
+    return 1;
+#else
     uint16_t mtu = gOptionJumbo ? XCPTL_SOCKET_JUMBO_MTU_SIZE : XCPTL_SOCKET_MTU_SIZE;
     r = udpTlInit(gOptionSlaveAddr, gOptionSlavePort, mtu);
     if (!r) return 0;
 
     // Create threads
-    create_thread(&gDAQThreadHandle,xcpSlaveDAQThread);
-    create_thread(&gCMDThreadHandle, xcpSlaveCMDThread);
+#ifdef XCPTL_ENABLE_IO_URING
+    if (gOptionUseIoUring) { // Single thread for command handling and DAQ transmit
+        create_thread(&gCMDThreadHandle, xcpSlaveUringThread);
+    }
+    else
+#endif
+    {
+        create_thread(&gDAQThreadHandle, xcpSlaveDAQThread);
+        create_thread(&gCMDThreadHandle, xcpSlaveCMDThread);
+    }
     sleepMs(200UL); 
 
     return 1;
+#endif
 }
 
 int xcpSlaveShutdown() {
 
+#ifdef XCP_ENABLE_MDF_RECORDER
+    mdfStop();
+#endif
     XcpDisconnect();
+#ifdef XCPTL_ENABLE_SHM
+    cancel_thread(gCMDThreadHandle);
+    shmTlShutdown();
+#else
+#ifdef XCPTL_ENABLE_IO_URING
+    if (!gOptionUseIoUring)
+#endif
     cancel_thread(gDAQThreadHandle);
     cancel_thread(gCMDThreadHandle);
     udpTlShutdown();
+#endif
+#ifdef XCP_ENABLE_CMD_QUEUE
+    cancel_thread(gCMDWorkerThreadHandle);
+#endif
+#ifdef XCP_ENABLE_CAL_STORE
+    calStoreClose(); // Write pending modifications, before the thread is cancelled
+    cancel_thread(gCalStoreThreadHandle);
+#endif
+#ifdef XCP_ENABLE_DAQ_RECORDER
+    recShutdown();
+#endif
     return 0;
 }
 
@@ -105,10 +177,21 @@ extern void* xcpSlaveCMDThread(void* par)
     for (;;) {
 
         // Handle incoming XCP commands
+#ifdef XCPTL_ENABLE_SHM
+        if (!shmTlHandleCommands()) { // Blocking with timeout
+            printf("ERROR: shmTlHandleCommands failed\n");
+            break; // exit
+        }
+#ifdef XCP_ENABLE_DAQ_RECORDER
+        // Transmit the recorded pre-trigger history after a trigger
+        recHandleTransmit();
+#endif
+#else
         if (!udpTlHandleCommands()) { // must be in nonblocking mode in single thread version, blocking mode with timeout in dual thread version
             printf("ERROR: udpTlHandleCommands failed\n"); 
             break; // exit
         }
+#endif
 
     } // for (;;)
 
@@ -118,6 +201,47 @@ extern void* xcpSlaveCMDThread(void* par)
 }
 
 
+#ifdef XCP_ENABLE_CMD_QUEUE
+
+// XCP command worker thread
+// Execute long running commands and the commands queued behind them, in order
+#ifdef _WIN
+DWORD WINAPI xcpSlaveCMDWorkerThread(LPVOID lpParameter)
+#else
+extern void* xcpSlaveCMDWorkerThread(void* par)
+#endif
+{
+    printf("Start XCP CMD worker thread\n");
+    for (;;) {
+        XcpHandleCommandQueue(XCP_CMD_QUEUE_WAIT_MS);
+    }
+    return 0;
+}
+
+#endif
+
+
+#ifdef XCP_ENABLE_CAL_STORE
+
+// XCP calibration store thread
+// Write the calibration snapshot to the store file, off the command path
+#ifdef _WIN
+DWORD WINAPI xcpSlaveCalStoreThread(LPVOID lpParameter)
+#else
+extern void* xcpSlaveCalStoreThread(void* par)
+#endif
+{
+    printf("Start XCP calibration store thread\n");
+    for (;;) {
+        calStoreHandle();
+        sleepMs(XCP_CAL_STORE_POLL_CYCLE_MS);
+    }
+    return 0;
+}
+
+#endif
+
+
 // XCP DAQ queue thread
 // Transmit DAQ data, flush DAQ data
 // May terminate on error
@@ -137,7 +261,12 @@ extern void* xcpSlaveDAQThread(void* par)
         if (XcpIsDaqRunning()) {
 
             // Wait for transmit data available, time out at least for required flush cycle
-            udpTlWaitForTransmitData(2000/*us*/);
+            udpTlWaitForTransmitData(gFlushCycleMs*1000/*us*/);
+
+#ifdef XCP_ENABLE_DAQ_RECORDER
+            // Move the recorded pre-trigger history to the transmit queue after a trigger
+            recHandleTransmit();
+#endif
 
             // Transmit all completed UDP packets from the transmit queue 
             if (!udpTlHandleTransmitQueue()) { // Must be in blocking mode with timeout
@@ -148,14 +277,19 @@ extern void* xcpSlaveDAQThread(void* par)
             // Every gFlushCycle in us time period
             // Cyclic flush of incomplete packets from transmit queue or transmit buffer to keep tool visualizations up to date
             // No priorisation of events implemented, no latency optimizations
-            if (gFlushCycleMs > 0 && gClock32 - gFlushTimer > gFlushCycleMs*CLOCK_TICKS_PER_MS) {
+            if (gFlushCycleMs > 0 && clockGet32() - gFlushTimer >= gFlushCycleMs*CLOCK_TICKS_PER_MS) {
                 gFlushTimer = gClock32;
                 udpTlFlushTransmitQueue();
             }
 
         } // DAQ
         else {
+#ifdef XCPTL_DTO_QUEUE_FREE_INDEX
+            // Transmit queue resets on DAQ start and stop are executed by this thread
+            udpTlWaitForTransmitReset(100000/*us*/);
+#else
             sleepMs(100);
+#endif
         }
 
     } // for (;;)
@@ -166,5 +300,49 @@ extern void* xcpSlaveDAQThread(void* par)
 }
 
 
+#ifdef XCPTL_ENABLE_IO_URING
+
+// XCP io_uring thread
+// Handle commands, transmit DAQ data, flush DAQ data
+// May terminate on error
+extern void* xcpSlaveUringThread(void* par)
+{
+    gXcpSlaveCMDThreadRunning = 1;
+    gXcpSlaveDAQThreadRunning = 1;
+    printf("Start XCP io_uring thread\n");
+
+    // Server loop
+    for (;;) {
+
+        // Handle incoming XCP commands and transmit all completed UDP packets from the transmit queue
+        // Wait for commands or transmit data available, time out at least for required flush cycle
+        if (!udpTlHandleIoUring(gFlushCycleMs*1000/*us*/)) {
+            printf("ERROR: udpTlHandleIoUring failed!\n"); // Error
+            break; // exit
+        }
+
+#ifdef XCP_ENABLE_DAQ_RECORDER
+        // Move the recorded pre-trigger history to the transmit queue after a trigger
+        if (XcpIsDaqRunning()) recHandleTransmit();
+#endif
+
+        // Every gFlushCycle in us time period
+        // Cyclic flush of incomplete packets from transmit queue or transmit buffer to keep tool visualizations up to date
+        if (XcpIsDaqRunning() && gFlushCycleMs > 0 && clockGet32() - gFlushTimer >= gFlushCycleMs*CLOCK_TICKS_PER_MS) {
+            gFlushTimer = gClock32;
+            udpTlFlushTransmitQueue();
+        }
+
+    } // for (;;)
+
+    gXcpSlaveCMDThreadRunning = 0;
+    gXcpSlaveDAQThreadRunning = 0;
+    printf("ERROR: xcpSlaveUringThread terminated!\n");
+    return 0;
+}
+
+#endif
+
+
 
 
@@ -26,6 +26,23 @@ DWORD WINAPI xcpSlaveDAQThread(LPVOID lpParameter);
 #else
 extern void* xcpSlaveDAQThread(void* par);
 #endif
+#ifdef XCPTL_ENABLE_IO_URING
+extern void* xcpSlaveUringThread(void* par);
+#endif
+#ifdef XCP_ENABLE_CMD_QUEUE
+#ifdef _WIN
+DWORD WINAPI xcpSlaveCMDWorkerThread(LPVOID lpParameter);
+#else
+extern void* xcpSlaveCMDWorkerThread(void* par);
+#endif
+#endif
+#ifdef XCP_ENABLE_CAL_STORE
+#ifdef _WIN
+DWORD WINAPI xcpSlaveCalStoreThread(LPVOID lpParameter);
+#else
+extern void* xcpSlaveCalStoreThread(void* par);
+#endif
+#endif
 
 
 #ifdef __cplusplus
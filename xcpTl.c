@@ -15,6 +15,15 @@
 #include "configuration.h"
 #include "xcpTl.h"
 
+#ifdef XCPTL_ENABLE_ZEROCOPY
+#include <linux/errqueue.h>
+#endif
+#ifdef XCPTL_ENABLE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#endif
+
 static void xcpTlInitDefaults();
 
 
@@ -25,7 +34,51 @@ tXcpTlData gXcpTl;
 #ifdef APP_ENABLE_MULTICAST
 static int udpTlHandleXcpMulticast(int n, tXcpCtoMessage* p);
 #endif
+#ifdef XCPTL_ENABLE_IO_URING
+static int udpTlHandleXcpCommands(int n, tXcpCtoMessage* p, tUdpSockAddr* src);
+#endif
+
+
+#ifdef XCPTL_ENABLE_TCP
+
+// Set TCP connection socket options
+static void tcpSetOptions(SOCKET sock) {
+
+    int nodelay = XCPTL_TCP_NODELAY;
+    int size = XCPTL_TCP_SOCKET_BUFFER_SIZE;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&nodelay, sizeof(nodelay));
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (const char*)&size, sizeof(size));
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (const char*)&size, sizeof(size));
+}
+
+// Transmit XCP messages on the TCP connection (contains multiple XCP DTO messages or a single CRM message)
+// Must be thread safe, because it is called from CMD and from DAQ thread
+// Data is discarded, if there is no connection
+// Returns 1 if ok, 0 on error
+static int tcpSend(const unsigned char* data, unsigned int size) {
+
+    unsigned int i = 0;
+    int r;
 
+    mutexLock(&gXcpTl.Mutex_Send);
+    if (gXcpTl.Sock.sock == INVALID_SOCKET) {
+        mutexUnlock(&gXcpTl.Mutex_Send);
+        return 1; // No connection, discard
+    }
+    while (i < size) {
+        r = (int)send(gXcpTl.Sock.sock, (const char*)data + i, size - i, TCP_SEND_FLAGS);
+        if (r <= 0) {
+            mutexUnlock(&gXcpTl.Mutex_Send);
+            printf("ERROR: send failed (result=%d, errno=%d)!\n", r, socketGetLastError());
+            return 0; // Error
+        }
+        i += (unsigned int)r;
+    }
+    mutexUnlock(&gXcpTl.Mutex_Send);
+    return 1;
+}
+
+#endif
 
 // Transmit a UDP datagramm (contains multiple XCP DTO messages or a single CRM message)
 // Must be thread safe, because it is called from CMD and from DAQ thread
@@ -42,6 +95,10 @@ static int sendDatagram(const unsigned char* data, unsigned int size ) {
     }
 #endif
 
+#ifdef XCPTL_ENABLE_TCP
+    if (gOptionUseTCP) return tcpSend(data, size);
+#endif
+
     // Respond to active master
     if (!gXcpTl.MasterAddrValid) {
         printf("ERROR: invalid master address!\n");
@@ -74,80 +131,811 @@ static int sendDatagram(const unsigned char* data, unsigned int size ) {
 
 //------------------------------------------------------------------------------
 // XCP (UDP) transport layer packet queue (DTO buffers)
+// Lock free, multiple producers (XCP events from any thread), single consumer (DAQ thread)
+// Producers reserve space for a DTO message in the current buffer by atomic update of the queue head
+// The DTO packet counter is part of the queue head, to keep the counter sequence in transmit order
+// The producer which detects a full buffer completes it by switching the queue head to the next buffer
+// A completed buffer is ready to send, when all its messages are commited
+
+// Queue head: index of the current buffer (bit 32..63), write offset in the current buffer (bit 16..31), next DTO packet counter (bit 0..15)
+#define QUEUE_HEAD(i,o,c) (((uint64_t)(i)<<32)|((uint64_t)(o)<<16)|(uint64_t)(uint16_t)(c))
+#define QUEUE_HEAD_INDEX(h) ((unsigned int)((h)>>32))
+#define QUEUE_HEAD_OFFSET(h) ((unsigned int)((h)>>16)&0xFFFF)
+#define QUEUE_HEAD_CTR(h) ((uint16_t)(h))
+
+static unsigned int nextDtoBufferIndex(unsigned int i) {
+    return (i + 1 >= XCPTL_DTO_QUEUE_SIZE) ? 0 : i + 1;
+}
 
-// Not thread save!
-static void getDtoBuffer() {
+static void notifyTransmitThread();
+#ifdef XCPTL_DTO_QUEUE_FREE_INDEX
+static void handleTransmitQueueReset();
+#endif
 
-    tXcpDtoBuffer* b;
+// Complete the current buffer of queue head h and switch to the next buffer
+// Returns 0 if there is no free buffer (queue overflow), 1 if ok or if h was outdated
+static int completeDtoBuffer(uint64_t h) {
+
+    unsigned int i = QUEUE_HEAD_INDEX(h);
+    unsigned int j = nextDtoBufferIndex(i);
 
     /* Check if there is space in the queue */
-    if (gXcpTl.dto_queue_len >= XCPTL_DTO_QUEUE_SIZE) {
-        /* Queue overflow */
-        gXcpTl.dto_buffer_ptr = NULL;
+#ifdef XCPTL_DTO_QUEUE_FREE_INDEX
+    if (j == atomicLoad32(&gXcpTl.dto_queue_fp)) return 0; // Queue overflow, sent buffers may still be in use by the kernel
+#else
+    if (j == atomicLoad32(&gXcpTl.dto_queue_rp)) return 0; // Queue overflow
+#endif
+
+    if (atomicCas64(&gXcpTl.dto_queue_head, h, QUEUE_HEAD(j, 0, QUEUE_HEAD_CTR(h)))) {
+        atomicStore32(&gXcpTl.dto_queue[i].xcp_size, QUEUE_HEAD_OFFSET(h)); // Final size, consumer may send it when fully commited
+        if (atomicLoad32(&gXcpTl.dto_queue[i].xcp_commited) == QUEUE_HEAD_OFFSET(h)) notifyTransmitThread(); // Ready to send
+    }
+    return 1;
+}
+
+// Check if the oldest buffer in the queue is completed and fully commited
+static int udpTlTransmitQueueHasData() {
+
+    tXcpDtoBuffer* b = &gXcpTl.dto_queue[atomicLoad32(&gXcpTl.dto_queue_rp)];
+    uint32_t size = atomicLoad32(&b->xcp_size);
+    return size != 0 && atomicLoad32(&b->xcp_commited) == size;
+}
+
+// Wake up the transmit thread, if it is waiting in udpTlWaitForTransmitData
+static void notifyTransmitThread() {
+
+    if (atomicLoad32(&gXcpTl.TxWaiting)) {
+        atomicStore32(&gXcpTl.TxWaiting, 0);
+#ifdef _LINUX
+        uint64_t v = 1;
+        if (write(gXcpTl.TxEvent, &v, sizeof(v)) < 0) { /* Event counter overflow, transmit thread is signaled anyway */ }
+#else
+        SetEvent(gXcpTl.TxEvent);
+#endif
+    }
+}
+
+#ifdef XCPTL_DTO_QUEUE_FREE_INDEX
+
+// Free all sent buffers from fp, which have been released by the kernel
+static void releaseDtoBuffers() {
+
+    tXcpDtoBuffer* b;
+
+    while (gXcpTl.dto_queue_fp != gXcpTl.dto_queue_rp) {
+        b = &gXcpTl.dto_queue[gXcpTl.dto_queue_fp];
+        if (!b->released) break;
+        b->xcp_size = 0;
+        b->xcp_commited = 0;
+        atomicStore32(&gXcpTl.dto_queue_fp, nextDtoBufferIndex(gXcpTl.dto_queue_fp));
+    }
+}
+
+#endif
+
+#ifdef XCPTL_ENABLE_ZEROCOPY
+
+// Read zero copy completion notifications from the socket error queue and release the buffers
+static void handleZeroCopyCompletions() {
+
+    struct msghdr msg;
+    union {
+        char buf[CMSG_SPACE(sizeof(struct sock_extended_err)) + CMSG_SPACE(sizeof(struct sockaddr_in))];
+        struct cmsghdr align;
+    } ctrl;
+    struct cmsghdr* cm;
+    struct sock_extended_err* ee;
+    uint32_t lo, hi;
+
+    for (;;) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = ctrl.buf;
+        msg.msg_controllen = sizeof(ctrl.buf);
+        if (recvmsg(gXcpTl.Sock.sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) break; // No more notifications
+        for (cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)) continue;
+            ee = (struct sock_extended_err*)CMSG_DATA(cm);
+            if (ee->ee_errno != 0 || ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+
+            // Notification ids lo..hi have been released, may include sends which have been copied
+            lo = ee->ee_info;
+            hi = ee->ee_data;
+            gXcpTl.ZcCompleted += hi - lo + 1;
+            if (ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) gXcpTl.ZcCopied += hi - lo + 1;
+            for (unsigned int i = gXcpTl.dto_queue_fp; i != gXcpTl.dto_queue_rp; i = nextDtoBufferIndex(i)) {
+                if (gXcpTl.dto_queue[i].zc_id - lo <= hi - lo) gXcpTl.dto_queue[i].released = 1;
+            }
+        }
+    }
+    releaseDtoBuffers();
+}
+
+static void printZeroCopyStatistics() {
+
+    printf("  Zero copy transmit: %u sent, %u completed, %u copied\n", gXcpTl.ZcSent, gXcpTl.ZcCompleted, gXcpTl.ZcCopied);
+}
+
+#endif
+
+#ifdef XCPTL_ENABLE_UDP_GSO
+
+// Pad a completed frame to the segment size (MTU) with fill bytes appended to its last DAQ DTO message
+// All frames of a GSO message except the last must have the segment size
+// The padded size is stored in the buffer, a frame collected again after a failed or partial send is not padded twice
+// Returns the new frame size, the size is not changed, if the last message is not a DAQ DTO or would exceed the maximum DTO size
+static uint32_t gsoPadFrame(tXcpDtoBuffer* b, uint32_t size) {
+
+    tXcpDtoMessage* p = NULL;
+    uint32_t o;
+
+    for (o = 0; o < size; o += XCPTL_TRANSPORT_LAYER_HEADER_SIZE + p->dlc) p = (tXcpDtoMessage*)&b->xcp[o];
+    if (p == NULL || p->dlc == 0 || p->data[0] >= PID_SERV) return size; // EV, SERV, ERR and RES packets keep their length
+    if (p->dlc + gXcpTl.SlaveMTU - size > XCPTL_DTO_SIZE) return size; // MAX_DTO exceeded
+    memset(&b->xcp[size], 0, gXcpTl.SlaveMTU - size);
+    p->dlc = (uint16_t)(p->dlc + gXcpTl.SlaveMTU - size);
+    gXcpTl.GsoFill += gXcpTl.SlaveMTU - size;
+    atomicStore32(&b->xcp_commited, gXcpTl.SlaveMTU);
+    atomicStore32(&b->xcp_size, gXcpTl.SlaveMTU);
+    return gXcpTl.SlaveMTU;
+}
+
+static void printGsoStatistics() {
+
+    printf("  UDP GSO transmit: %u messages, %u frames, %.1f frames per message, %u fill bytes\n", gXcpTl.GsoMessages, gXcpTl.GsoFrames,
+        gXcpTl.GsoMessages ? (double)gXcpTl.GsoFrames / gXcpTl.GsoMessages : 0.0, gXcpTl.GsoFill);
+}
+
+#endif
+
+//------------------------------------------------------------------------------
+// io_uring transport backend (Linux)
+// A single thread handles command receive and DTO transmit with one io_uring
+// A recvmsg for CRO packets is permanently armed, completed DTO buffers are submitted as a chain of linked sendmsg operations
+// Producers wake up the thread with the transmit event, which is polled by the ring
+
+#ifdef XCPTL_ENABLE_IO_URING
+
+#define URING_TAG_RECV  0x10000 // user_data of the recvmsg operation
+#define URING_TAG_EVENT 0x20000 // user_data of the transmit event poll operation, user_data of sendmsg operations is the DTO buffer index
+
+static int uringEnter(unsigned int toSubmit, unsigned int minComplete, unsigned int flags, void* arg, size_t argSize) {
+    return (int)syscall(__NR_io_uring_enter, gXcpTl.Uring.fd, toSubmit, minComplete, flags, arg, argSize);
+}
+
+// Get a cleared submission queue entry, returns NULL if the submission queue is full
+static struct io_uring_sqe* uringGetSqe() {
+
+    tXcpTlUring* u = &gXcpTl.Uring;
+    struct io_uring_sqe* sqe;
+    uint32_t i;
+
+    if (u->sq_tail_local - atomicLoad32(u->sq_head) >= u->sq_entries) return NULL;
+    i = u->sq_tail_local & u->sq_mask;
+    sqe = &u->sqes[i];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_array[i] = i;
+    u->sq_tail_local++;
+    return sqe;
+}
+
+// Submit all prepared submission queue entries and optionally wait at most timeout_us for at least one completion
+static int uringSubmit(unsigned int timeout_us) {
+
+    tXcpTlUring* u = &gXcpTl.Uring;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    unsigned int n;
+    int r;
+
+    atomicStore32(u->sq_tail, u->sq_tail_local);
+    n = u->sq_tail_local - atomicLoad32(u->sq_head);
+    if (timeout_us > 0) {
+        ts.tv_sec = timeout_us / 1000000;
+        ts.tv_nsec = (timeout_us % 1000000) * 1000;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+        r = uringEnter(n, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
     }
     else {
-        unsigned int i = gXcpTl.dto_queue_rp + gXcpTl.dto_queue_len;
-        if (i >= XCPTL_DTO_QUEUE_SIZE) i -= XCPTL_DTO_QUEUE_SIZE;
+        if (n == 0) return 1;
+        r = uringEnter(n, 0, 0, NULL, 0);
+    }
+    if (r < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) {
+        printf("ERROR: io_uring_enter failed (errno=%d)!\n", errno);
+        return 0;
+    }
+    return 1;
+}
+
+// Arm the receive operation for the next CRO packet
+static int uringArmRecv() {
+
+    tXcpTlUring* u = &gXcpTl.Uring;
+    struct io_uring_sqe* sqe = uringGetSqe();
+
+    if (sqe == NULL) return 0;
+    u->rx_iov.iov_base = u->rx_buffer;
+    u->rx_iov.iov_len = sizeof(u->rx_buffer);
+    memset(&u->rx_msg, 0, sizeof(u->rx_msg));
+    u->rx_msg.msg_name = &u->rx_src.addr;
+    u->rx_msg.msg_namelen = sizeof(u->rx_src.addr);
+    u->rx_msg.msg_iov = &u->rx_iov;
+    u->rx_msg.msg_iovlen = 1;
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = gXcpTl.Sock.sock;
+    sqe->addr = (uint64_t)(uintptr_t)&u->rx_msg;
+    sqe->len = 1;
+    sqe->user_data = URING_TAG_RECV;
+    return 1;
+}
+
+// Arm the poll operation for the transmit event
+static int uringArmEvent() {
+
+    struct io_uring_sqe* sqe = uringGetSqe();
+
+    if (sqe == NULL) return 0;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = gXcpTl.TxEvent;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = URING_TAG_EVENT;
+    return 1;
+}
+
+// Submit all completed and fully commited DTO buffers as a chain of linked send operations
+// A new chain is started when the previous one has completed, to keep the transmit order
+static int uringHandleTransmitQueue() {
+
+    tXcpTlUring* u = &gXcpTl.Uring;
+    struct io_uring_sqe* sqe = NULL;
+    tXcpDtoBuffer* b;
+    uint32_t size;
+    unsigned int i;
+
+    if (u->sends > 0) return 1; // Previous chain still in flight
+
+    for (;;) {
+
+        // Check
+        i = gXcpTl.dto_queue_rp;
         b = &gXcpTl.dto_queue[i];
-        b->xcp_size = 0;
-        b->xcp_uncommited = 0;
-        gXcpTl.dto_buffer_ptr = b;
-        gXcpTl.dto_queue_len++;
+        size = atomicLoad32(&b->xcp_size);
+        if (size == 0 || atomicLoad32(&b->xcp_commited) != size) break; // Not completed or not fully commited
+
+        // Respond to active master
+        if (!gXcpTl.MasterAddrValid) {
+            printf("ERROR: invalid master address!\n");
+            return 0;
+        }
+
+        // Prepare send operation
+        struct io_uring_sqe* s = uringGetSqe();
+        if (s == NULL) break; // Submission queue full
+        sqe = s;
+        u->tx_iov[i].iov_base = &b->xcp[0];
+        u->tx_iov[i].iov_len = size;
+        memset(&u->tx_msg[i], 0, sizeof(u->tx_msg[i]));
+        u->tx_msg[i].msg_name = &gXcpTl.MasterAddr.addr;
+        u->tx_msg[i].msg_namelen = sizeof(gXcpTl.MasterAddr.addr);
+        u->tx_msg[i].msg_iov = &u->tx_iov[i];
+        u->tx_msg[i].msg_iovlen = 1;
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = gXcpTl.Sock.sock;
+        sqe->addr = (uint64_t)(uintptr_t)&u->tx_msg[i];
+        sqe->len = 1;
+        sqe->flags = IOSQE_IO_LINK;
+        sqe->user_data = i;
+        b->released = 0;
+        u->sends++;
+        atomicStore32(&gXcpTl.dto_queue_rp, nextDtoBufferIndex(i));
     }
+
+    if (sqe == NULL) return 1; // Nothing to send
+    sqe->flags = 0; // End of chain
+    return uringSubmit(0);
 }
 
+// Handle all completions
+// Received commands are handled only if handleCommands, otherwise the receive operation is rearmed later
+static int uringHandleCompletions(int handleCommands) {
+
+    tXcpTlUring* u = &gXcpTl.Uring;
+    struct io_uring_cqe* cqe;
+    uint32_t head = *u->cq_head;
+    uint64_t tag;
+    uint64_t v;
+    int res;
+    int n;
+
+    while (head != atomicLoad32(u->cq_tail)) {
+        cqe = &u->cqes[head & u->cq_mask];
+        tag = cqe->user_data;
+        res = cqe->res;
+        atomicStore32(u->cq_head, ++head);
+
+        if (tag == URING_TAG_RECV) {
+            if (res < 0) {
+                printf("ERROR: io_uring recvmsg failed (errno=%d)!\n", -res);
+                return 0; // Error
+            }
+            u->rx_len = res;
+        }
+        else if (tag == URING_TAG_EVENT) {
+            if (read(gXcpTl.TxEvent, &v, sizeof(v)) < 0) { /* Not signaled */ } // Reset the event counter
+            u->event_armed = 0;
+        }
+        else {
+            if (res < 0) {
+                printf("ERROR: io_uring sendmsg failed (errno=%d)!\n", -res);
+            }
+            gXcpTl.dto_queue[tag].released = 1;
+            u->sends--;
+        }
+    }
+    releaseDtoBuffers();
+
+    // Handle a received command and receive the next
+    if (handleCommands && u->rx_len >= 0) {
+        n = u->rx_len;
+        u->rx_len = -1;
+        if (!udpTlHandleXcpCommands(n, (tXcpCtoMessage*)u->rx_buffer, &u->rx_src)) return 0;
+        if (!uringArmRecv()) return 0;
+    }
+
+    // Rearm the transmit event
+    if (!u->event_armed) {
+        if (!uringArmEvent()) return 0;
+        u->event_armed = 1;
+    }
+
+    return uringSubmit(0);
+}
+
+// Handle commands and transmit DTO buffers, wait at most timeout_us for receive or transmit events
+int udpTlHandleIoUring(unsigned int timeout_us) {
+
+    handleTransmitQueueReset();
+    if (!uringHandleTransmitQueue()) return 0;
+
+    // Announce waiting and check again, to avoid a lost wakeup
+    atomicStore32(&gXcpTl.TxWaiting, 1);
+    if (gXcpTl.Uring.sends == 0 && udpTlTransmitQueueHasData()) timeout_us = 0;
+    if (!uringSubmit(timeout_us)) return 0;
+    atomicStore32(&gXcpTl.TxWaiting, 0);
+
+    return uringHandleCompletions(TRUE);
+}
+
+static int uringInit() {
+
+    tXcpTlUring* u = &gXcpTl.Uring;
+    struct io_uring_params p;
+    size_t sqSize, cqSize;
+    uint8_t* ring;
+
+    memset(&p, 0, sizeof(p));
+    u->fd = (int)syscall(__NR_io_uring_setup, XCPTL_IO_URING_ENTRIES, &p);
+    if (u->fd < 0) return 0;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG)) {
+        close(u->fd);
+        return 0;
+    }
+
+    // Map submission and completion queue rings (single mapping) and submission queue entries
+    sqSize = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->ring_size = sqSize > cqSize ? sqSize : cqSize;
+    u->ring = mmap(NULL, u->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    if (u->ring == MAP_FAILED) {
+        close(u->fd);
+        return 0;
+    }
+    u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = (struct io_uring_sqe*)mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if ((void*)u->sqes == MAP_FAILED) {
+        munmap(u->ring, u->ring_size);
+        close(u->fd);
+        return 0;
+    }
+    ring = (uint8_t*)u->ring;
+    u->sq_head = (volatile uint32_t*)(ring + p.sq_off.head);
+    u->sq_tail = (volatile uint32_t*)(ring + p.sq_off.tail);
+    u->sq_mask = *(uint32_t*)(ring + p.sq_off.ring_mask);
+    u->sq_entries = p.sq_entries;
+    u->sq_array = (uint32_t*)(ring + p.sq_off.array);
+    u->sq_tail_local = *u->sq_tail;
+    u->cq_head = (volatile uint32_t*)(ring + p.cq_off.head);
+    u->cq_tail = (volatile uint32_t*)(ring + p.cq_off.tail);
+    u->cq_mask = *(uint32_t*)(ring + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe*)(ring + p.cq_off.cqes);
+
+    u->sends = 0;
+    u->rx_len = -1;
+    u->event_armed = 1;
+    return uringArmRecv() && uringArmEvent() && uringSubmit(0);
+}
+
+static void uringShutdown() {
+
+    tXcpTlUring* u = &gXcpTl.Uring;
+
+    munmap(u->sqes, u->sqes_size);
+    munmap(u->ring, u->ring_size);
+    close(u->fd);
+}
+
+#endif
+
 // Clear and init transmit queue
+// Not thread safe, must not be called while XCP events are processed
+static void resetTransmitQueue() {
+
+#ifdef XCPTL_DTO_QUEUE_FREE_INDEX
+    // Wait until the kernel has released all buffers in use
+    for (unsigned int t = 0; t < 100 && gXcpTl.dto_queue_fp != gXcpTl.dto_queue_rp; t++) {
+#ifdef XCPTL_ENABLE_IO_URING
+        if (gOptionUseIoUring) {
+            uringSubmit(1000);
+            uringHandleCompletions(FALSE);
+            continue;
+        }
+#endif
+#ifdef XCPTL_ENABLE_ZEROCOPY
+        handleZeroCopyCompletions();
+        if (gXcpTl.dto_queue_fp != gXcpTl.dto_queue_rp) sleepMs(1);
+#endif
+    }
+    if (gXcpTl.dto_queue_fp != gXcpTl.dto_queue_rp) printf("WARNING: DTO buffers still in use by the kernel!\n");
+#endif
+#if defined ( XCP_ENABLE_TESTMODE ) && defined ( XCPTL_ENABLE_ZEROCOPY )
+    if (gDebugLevel >= 2 && gXcpTl.ZcEnabled) printZeroCopyStatistics();
+#endif
+#if defined ( XCP_ENABLE_TESTMODE ) && defined ( XCPTL_ENABLE_UDP_GSO )
+    if (gDebugLevel >= 2 && gXcpTl.GsoEnabled) printGsoStatistics();
+#endif
+
+    for (unsigned int i = 0; i < XCPTL_DTO_QUEUE_SIZE; i++) {
+        gXcpTl.dto_queue[i].xcp_size = 0;
+        gXcpTl.dto_queue[i].xcp_commited = 0;
+    }
+    atomicStore32(&gXcpTl.dto_queue_rp, 0);
+#ifdef XCPTL_DTO_QUEUE_FREE_INDEX
+    atomicStore32(&gXcpTl.dto_queue_fp, 0);
+#endif
+    atomicStore64(&gXcpTl.dto_queue_head, QUEUE_HEAD(0, 0, QUEUE_HEAD_CTR(atomicLoad64(&gXcpTl.dto_queue_head)))); // Keep the DTO packet counter
+}
+
+#ifdef XCPTL_DTO_QUEUE_FREE_INDEX
+
+// Register the calling thread as the transmit thread and execute a pending transmit queue reset request
+static void handleTransmitQueueReset() {
+
+    if (!atomicLoad32(&gXcpTl.TxThreadValid)) {
+        gXcpTl.TxThread = pthread_self();
+        atomicStore32(&gXcpTl.TxThreadValid, 1);
+    }
+    if (atomicCas32(&gXcpTl.TxResetRequest, 1, 2)) {
+        resetTransmitQueue();
+        atomicStore32(&gXcpTl.TxResetRequest, 0);
+    }
+}
+
+#endif
+
+// Clear and init transmit queue, called on DAQ start and stop
+// Must not be called while XCP events are processed
+// Buffers may still be in use by the kernel and their release notifications are handled by the transmit thread,
+// so the reset is posted to the transmit thread, if called from another thread (command handler or command worker)
 void udpTlInitTransmitQueue() {
 
-    mutexLock(&gXcpTl.Mutex_Queue);
-    gXcpTl.dto_queue_rp = 0;
-    gXcpTl.dto_queue_len = 0;
-    gXcpTl.dto_buffer_ptr = NULL;
-    getDtoBuffer();
-    mutexUnlock(&gXcpTl.Mutex_Queue);
-    assert(gXcpTl.dto_buffer_ptr);
+#ifdef XCPTL_DTO_QUEUE_FREE_INDEX
+    if (atomicLoad32(&gXcpTl.TxThreadValid) && !pthread_equal(pthread_self(), gXcpTl.TxThread)) {
+        atomicStore32(&gXcpTl.TxResetRequest, 1);
+        notifyTransmitThread();
+        for (unsigned int t = 0; t < 1000 && atomicLoad32(&gXcpTl.TxResetRequest) != 0; t++) sleepMs(1);
+        if (!atomicCas32(&gXcpTl.TxResetRequest, 1, 0)) { // Taken by the transmit thread
+            while (atomicLoad32(&gXcpTl.TxResetRequest) != 0) sleepMs(1);
+            return;
+        }
+        printf("WARNING: transmit thread not responding, transmit queue reset by the caller!\n");
+    }
+#endif
+    resetTransmitQueue();
+}
+
+#if defined(_LINUX) && defined(XCPTL_ENABLE_TCP)
+
+// Linux TCP: Stream all completed and fully commited DTO buffers with sendmsg, MSG_NOSIGNAL avoids SIGPIPE on a lost connection
+// Buffers are discarded, if the connection is lost
+static int tcpHandleTransmitQueue() {
+
+    struct iovec iov[XCPTL_DTO_QUEUE_SIZE];
+    struct msghdr msg;
+    tXcpDtoBuffer* b;
+    uint32_t size;
+    unsigned int rp, n, cnt;
+    ssize_t r;
+
+    for (;;) {
+
+        // Collect completed and fully commited buffers
+        rp = gXcpTl.dto_queue_rp;
+        for (n = 0; n < XCPTL_DTO_QUEUE_SIZE; n++) {
+            b = &gXcpTl.dto_queue[rp];
+            size = atomicLoad32(&b->xcp_size);
+            if (size == 0 || atomicLoad32(&b->xcp_commited) != size) break; // Not completed or not fully commited
+            iov[n].iov_base = &b->xcp[0];
+            iov[n].iov_len = size;
+            rp = nextDtoBufferIndex(rp);
+        }
+        if (n == 0) break; // Queue empty
+
+#if defined ( XCP_ENABLE_TESTMODE )
+        if (gDebugLevel >= 3) {
+            printf("TX: %u buffers\n", n);
+        }
+#endif
+
+        // Write all buffers, continue on partial writes
+        mutexLock(&gXcpTl.Mutex_Send);
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+        cnt = n;
+        while (cnt > 0 && gXcpTl.Sock.sock != INVALID_SOCKET) {
+            r = sendmsg(gXcpTl.Sock.sock, &msg, TCP_SEND_FLAGS);
+            if (r < 0) {
+                if (errno == EINTR) continue;
+                printf("WARNING: TCP send failed (errno=%d), DTO data discarded!\n", errno);
+                break; // Connection lost, the CMD thread will close it
+            }
+            while (cnt > 0 && (size_t)r >= msg.msg_iov->iov_len) {
+                r -= (ssize_t)msg.msg_iov->iov_len;
+                msg.msg_iov++;
+                cnt--;
+            }
+            if (cnt > 0) {
+                msg.msg_iov->iov_base = (uint8_t*)msg.msg_iov->iov_base + r;
+                msg.msg_iov->iov_len -= (size_t)r;
+            }
+            msg.msg_iovlen = cnt;
+        }
+        mutexUnlock(&gXcpTl.Mutex_Send);
+
+        // Free the buffers
+        while (n-- > 0) {
+            b = &gXcpTl.dto_queue[gXcpTl.dto_queue_rp];
+            b->xcp_size = 0;
+            b->xcp_commited = 0;
+            atomicStore32(&gXcpTl.dto_queue_rp, nextDtoBufferIndex(gXcpTl.dto_queue_rp));
+        }
+#ifdef XCPTL_DTO_QUEUE_FREE_INDEX
+        atomicStore32(&gXcpTl.dto_queue_fp, gXcpTl.dto_queue_rp);
+#endif
+
+    } // for (;;)
+
+    return 1; // Ok, queue empty now
 }
 
+#endif
+
 // Transmit all completed and fully commited UDP frames
 // Returns -1 would block, 1 ok, 0 error
+#if defined(_LINUX) && (XCPTL_SEND_BATCH_SIZE > 1 || defined(XCPTL_ENABLE_UDP_GSO) || defined(XCPTL_ENABLE_ZEROCOPY) || defined(XCPTL_ENABLE_IO_URING) || defined(XCPTL_ENABLE_TCP))
+
+// Linux: Hand over up to XCPTL_SEND_BATCH_SIZE UDP messages to the kernel with a single sendmmsg call
+// With UDP GSO, a message may contain multiple UDP frames of MTU size (the last may be shorter), which are segmented by the kernel or NIC
+// With zero copy, sent buffers stay pinned until the kernel notifies their release on the socket error queue
 int udpTlHandleTransmitQueue( void ) {
 
+    struct mmsghdr msgs[XCPTL_SEND_BATCH_SIZE];
+    struct iovec iov[XCPTL_DTO_QUEUE_SIZE];
+#ifdef XCPTL_ENABLE_UDP_GSO
+    union {
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+        struct cmsghdr align;
+    } gsoCtrl[XCPTL_SEND_BATCH_SIZE];
+    struct cmsghdr* cm;
+    int gso = 0;
+    tXcpDtoBuffer* prev = NULL;
+#endif
     tXcpDtoBuffer* b;
-    int result;
+    uint32_t size;
+    unsigned int rp, n, m, i, j;
+    unsigned int retries = SEND_RETRIES;
+    int flags;
+    int r;
+
+#ifdef XCPTL_ENABLE_IO_URING
+    if (gOptionUseIoUring) return uringHandleTransmitQueue();
+#endif
+#ifdef XCPTL_ENABLE_TCP
+    if (gOptionUseTCP) return tcpHandleTransmitQueue();
+#endif
 
     for (;;) {
 
-        // Check
-        mutexLock(&gXcpTl.Mutex_Queue);
-        if (gXcpTl.dto_queue_len > 1) {
-            b = &gXcpTl.dto_queue[gXcpTl.dto_queue_rp];
-            if (b->xcp_uncommited > 0) b = NULL; 
+#ifdef XCPTL_ENABLE_ZEROCOPY
+        // Recycle buffers released by the kernel
+        if (gXcpTl.dto_queue_fp != gXcpTl.dto_queue_rp) handleZeroCopyCompletions();
+#endif
+
+        // Collect completed and fully commited frames
+        rp = gXcpTl.dto_queue_rp;
+        for (n = 0, m = 0; n < XCPTL_DTO_QUEUE_SIZE; n++) {
+            b = &gXcpTl.dto_queue[rp];
+            size = atomicLoad32(&b->xcp_size);
+            if (size == 0 || atomicLoad32(&b->xcp_commited) != size) break; // Not completed or not fully commited
+            iov[n].iov_base = &b->xcp[0];
+            iov[n].iov_len = size;
+#ifdef XCPTL_ENABLE_UDP_GSO
+            // Append this frame as another segment to the current message, if all its segments have the segment size (MTU)
+            // Frames are closed at different fill levels, the previous frame is padded to the segment size, only the last frame of a message may be shorter
+            if (gXcpTl.GsoEnabled && m > 0) {
+                struct msghdr* h = &msgs[m - 1].msg_hdr;
+                if (h->msg_iovlen < XCPTL_GSO_MAX_SEGMENTS && (h->msg_iovlen + 1) * gXcpTl.SlaveMTU <= XCPTL_GSO_MAX_SIZE) {
+                    if (iov[n - 1].iov_len < gXcpTl.SlaveMTU) iov[n - 1].iov_len = gsoPadFrame(prev, (uint32_t)iov[n - 1].iov_len);
+                    if (iov[n - 1].iov_len == gXcpTl.SlaveMTU) {
+                        h->msg_iovlen++;
+                        rp = nextDtoBufferIndex(rp);
+                        prev = b;
+                        continue;
+                    }
+                }
+            }
+            prev = b;
+#endif
+            if (m >= XCPTL_SEND_BATCH_SIZE) break;
+            memset(&msgs[m], 0, sizeof(msgs[m]));
+            msgs[m].msg_hdr.msg_name = &gXcpTl.MasterAddr.addr;
+            msgs[m].msg_hdr.msg_namelen = sizeof(gXcpTl.MasterAddr.addr);
+            msgs[m].msg_hdr.msg_iov = &iov[n];
+            msgs[m].msg_hdr.msg_iovlen = 1;
+            m++;
+            rp = nextDtoBufferIndex(rp);
         }
-        else {
-            b = NULL;
+        if (m == 0) break; // Queue empty
+
+        // Respond to active master
+        if (!gXcpTl.MasterAddrValid) {
+            printf("ERROR: invalid master address!\n");
+            return 0;
         }
-        mutexUnlock(&gXcpTl.Mutex_Queue);
-        if (b == NULL) break;
+
+#ifdef XCPTL_ENABLE_UDP_GSO
+        // Set the segment size for messages with multiple frames
+        gso = 0;
+        for (i = 0; i < m; i++) {
+            if (msgs[i].msg_hdr.msg_iovlen > 1) {
+                msgs[i].msg_hdr.msg_control = gsoCtrl[i].buf;
+                msgs[i].msg_hdr.msg_controllen = sizeof(gsoCtrl[i].buf);
+                cm = CMSG_FIRSTHDR(&msgs[i].msg_hdr);
+                cm->cmsg_level = SOL_UDP;
+                cm->cmsg_type = UDP_SEGMENT;
+                cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                *(uint16_t*)CMSG_DATA(cm) = (uint16_t)msgs[i].msg_hdr.msg_iov[0].iov_len;
+                gso = 1;
+            }
+        }
+#endif
+
+#if defined ( XCP_ENABLE_TESTMODE )
+        if (gDebugLevel >= 3) {
+            printf("TX: %u frames in %u messages\n", n, m);
+        }
+#endif
+
+        // Send these frames
+        flags = SENDTO_FLAGS;
+#ifdef XCPTL_ENABLE_ZEROCOPY
+        if (gXcpTl.ZcEnabled) flags |= MSG_ZEROCOPY;
+#endif
+        mutexLock(&gXcpTl.Mutex_Send);
+        r = sendmmsg(gXcpTl.Sock.sock, msgs, m, flags);
+        mutexUnlock(&gXcpTl.Mutex_Send);
+        if (r <= 0) {
+#ifdef XCPTL_ENABLE_ZEROCOPY
+            if (r < 0 && gXcpTl.ZcEnabled && socketGetLastError() == ENOBUFS) { // Too many pending zero copy notifications
+                if (--retries == 0) return -1; // Would block
+                handleZeroCopyCompletions();
+                sleepNs(1000);
+                continue; // Retry
+            }
+#endif
+            if (r < 0 && socketGetLastError() == SOCKET_ERROR_WBLOCK) {
+                if (--retries == 0) return -1; // Would block
+                sleepNs(1000);
+                continue; // Retry
+            }
+#ifdef XCPTL_ENABLE_UDP_GSO
+            if (r < 0 && gso) { // Segmentation offload not supported by the route or device
+                printf("WARNING: UDP GSO failed (errno=%d), disabled!\n", socketGetLastError());
+                gXcpTl.GsoEnabled = 0;
+                continue; // Retry without GSO
+            }
+#endif
+            printf("ERROR: sendmmsg failed (result=%d, errno=%d)!\n", r, socketGetLastError());
+            return 0; // Error
+        }
+
+        // Free the buffers succesfully sent, continue with the remaining frames on partial send
+        for (i = 0; i < (unsigned int)r; i++) {
+#ifdef XCPTL_ENABLE_UDP_GSO
+            gXcpTl.GsoMessages++;
+            gXcpTl.GsoFrames += (uint32_t)msgs[i].msg_hdr.msg_iovlen;
+#endif
+            for (j = 0; j < msgs[i].msg_hdr.msg_iovlen; j++) {
+                b = &gXcpTl.dto_queue[gXcpTl.dto_queue_rp];
+#ifdef XCPTL_ENABLE_ZEROCOPY
+                if (gXcpTl.ZcEnabled) { // Keep pinned until the kernel notifies the release of this send
+                    b->zc_id = gXcpTl.ZcNextId + i;
+                    b->released = 0;
+                }
+                else
+#endif
+                {
+                    b->xcp_size = 0;
+                    b->xcp_commited = 0;
+                }
+                atomicStore32(&gXcpTl.dto_queue_rp, nextDtoBufferIndex(gXcpTl.dto_queue_rp));
+            }
+        }
+#ifdef XCPTL_ENABLE_ZEROCOPY
+        if (gXcpTl.ZcEnabled) {
+            gXcpTl.ZcNextId += (uint32_t)r; // Each sent message gets the next notification id
+            gXcpTl.ZcSent += (uint32_t)r;
+        }
+        else
+#endif
+        {
+#ifdef XCPTL_DTO_QUEUE_FREE_INDEX
+            atomicStore32(&gXcpTl.dto_queue_fp, gXcpTl.dto_queue_rp);
+#endif
+        }
+        retries = SEND_RETRIES;
+
+    } // for (;;)
+
+    return 1; // Ok, queue empty now
+}
+
+#else
+
+int udpTlHandleTransmitQueue( void ) {
+
+    tXcpDtoBuffer* b;
+    uint32_t size;
+    int result;
+
+    for (;;) {
+
+        // Check
+        b = &gXcpTl.dto_queue[gXcpTl.dto_queue_rp];
+        size = atomicLoad32(&b->xcp_size);
+        if (size == 0 || atomicLoad32(&b->xcp_commited) != size) break; // Not completed or not fully commited
 
         // Send this frame
-        result = sendDatagram(&b->xcp[0], b->xcp_size);
+        result = sendDatagram(&b->xcp[0], size);
         if (result != 1) return result; // return on errors or if would block
 
         // Free this buffer when succesfully sent
-        mutexLock(&gXcpTl.Mutex_Queue);
-        gXcpTl.dto_queue_rp++;
-        if (gXcpTl.dto_queue_rp >= XCPTL_DTO_QUEUE_SIZE) gXcpTl.dto_queue_rp -= XCPTL_DTO_QUEUE_SIZE;
-        gXcpTl.dto_queue_len--;
-        mutexUnlock(&gXcpTl.Mutex_Queue);
+        b->xcp_size = 0;
+        b->xcp_commited = 0;
+        atomicStore32(&gXcpTl.dto_queue_rp, nextDtoBufferIndex(gXcpTl.dto_queue_rp));
 
     } // for (;;)
 
     return 1; // Ok, queue empty now
 }
 
+#endif
+
 // Transmit all committed DTOs
 void udpTlFlushTransmitQueue() {
 
+    uint64_t h;
+
 #if defined ( XCP_ENABLE_TESTMODE )
     if (gDebugLevel >= 3) {
         printf("FlushTransmitQueue()\n");
@@ -155,76 +943,128 @@ void udpTlFlushTransmitQueue() {
 #endif
 
     // Complete the current buffer if non empty
-    mutexLock(&gXcpTl.Mutex_Queue);               
-    if (gXcpTl.dto_buffer_ptr!=NULL && gXcpTl.dto_buffer_ptr->xcp_size>0) getDtoBuffer();
-    mutexUnlock(&gXcpTl.Mutex_Queue);
+    h = atomicLoad64(&gXcpTl.dto_queue_head);
+    if (QUEUE_HEAD_OFFSET(h) > 0) completeDtoBuffer(h);
         
     udpTlHandleTransmitQueue();
 }
 
-// Reserve space for a DTO packet in a DTO buffer and return a pointer to data and a pointer to the buffer for commit reference
-// Flush the transmit buffer, if no space left
+// Reserve space for a DTO packet in a DTO buffer and return a pointer to data and a pointer to the packet for commit reference
+// Complete the current buffer and switch to the next, if no space left
+// Thread safe and lock free
 unsigned char *udpTlGetPacketBuffer(void **par, unsigned int size) {
 
     tXcpDtoMessage* p;
+    uint64_t h;
+    unsigned int o;
+    unsigned int n = size + XCPTL_TRANSPORT_LAYER_HEADER_SIZE;
 
- #if defined ( XCP_ENABLE_TESTMODE )
-    if (gDebugLevel >= 4) {
-        printf("GetPacketBuffer(%u)\n", size);
-        if (gXcpTl.dto_buffer_ptr) {
-            printf("  current dto_buffer_ptr size=%u, c=%u\n", gXcpTl.dto_buffer_ptr->xcp_size, gXcpTl.dto_buffer_ptr->xcp_uncommited);
+    if (n > gXcpTl.SlaveMTU) return NULL; // Does not fit into any buffer
+
+    for (;;) {
+        h = atomicLoad64(&gXcpTl.dto_queue_head);
+        o = QUEUE_HEAD_OFFSET(h);
+        if (o + n <= gXcpTl.SlaveMTU) {
+            // Reserve space in the current buffer and get a DTO packet counter
+            if (atomicCas64(&gXcpTl.dto_queue_head, h, QUEUE_HEAD(QUEUE_HEAD_INDEX(h), o + n, QUEUE_HEAD_CTR(h) + 1))) break;
         }
         else {
-            printf("  dto_buffer_ptr = NULL\n");
+            // Get another message buffer from queue, when active buffer ist full
+            if (!completeDtoBuffer(h)) return NULL; // Overflow
         }
     }
-#endif
-
-    mutexLock(&gXcpTl.Mutex_Queue);
-        
-    // Get another message buffer from queue, when active buffer ist full, overrun or after time condition
-    if (gXcpTl.dto_buffer_ptr==NULL || gXcpTl.dto_buffer_ptr->xcp_size + size + XCPTL_TRANSPORT_LAYER_HEADER_SIZE > gXcpTl.SlaveMTU /*XCPTL_SOCKET_MTU_SIZE*/) {
-        getDtoBuffer();
-    }
 
-    if (gXcpTl.dto_buffer_ptr != NULL) {
-
-        // Build XCP message header (ctr+dlc) and store in DTO buffer
-        p = (tXcpDtoMessage*)&gXcpTl.dto_buffer_ptr->xcp[gXcpTl.dto_buffer_ptr->xcp_size];
-        p->ctr = gXcpTl.DtoCtr++;
-        p->dlc = (uint16_t)size;
-        gXcpTl.dto_buffer_ptr->xcp_size += size + XCPTL_TRANSPORT_LAYER_HEADER_SIZE;
-
-        *((tXcpDtoBuffer**)par) = gXcpTl.dto_buffer_ptr;
-        gXcpTl.dto_buffer_ptr->xcp_uncommited++;
-    }
-    else {
-        p = NULL; // Overflow
+#if defined ( XCP_ENABLE_TESTMODE )
+    if (gDebugLevel >= 4) {
+        printf("GetPacketBuffer(%u) buffer=%u, offset=%u, ctr=%u\n", size, QUEUE_HEAD_INDEX(h), o, QUEUE_HEAD_CTR(h));
     }
+#endif
 
-    mutexUnlock(&gXcpTl.Mutex_Queue);
+    // Build XCP message header (ctr+dlc) and store in DTO buffer
+    p = (tXcpDtoMessage*)&gXcpTl.dto_queue[QUEUE_HEAD_INDEX(h)].xcp[o];
+    p->ctr = QUEUE_HEAD_CTR(h);
+    p->dlc = (uint16_t)size;
 
-    if (p == NULL) return NULL; // Overflow
+    *((tXcpDtoMessage**)par) = p;
     return &p->data[0]; // return pointer to XCP message DTO data
 }
 
+// Commit a DTO packet reserved by udpTlGetPacketBuffer
+// Thread safe and lock free
 void udpTlCommitPacketBuffer(void *par) {
 
-    tXcpDtoBuffer* p = (tXcpDtoBuffer*)par;
+    tXcpDtoMessage* p = (tXcpDtoMessage*)par;
+    tXcpDtoBuffer* b;
 
     if (par != NULL) {
 
+        b = &gXcpTl.dto_queue[((unsigned char*)p - (unsigned char*)&gXcpTl.dto_queue[0]) / sizeof(tXcpDtoBuffer)];
+
 #if defined ( XCP_ENABLE_TESTMODE )
         if (gDebugLevel >= 4) {
-            printf("CommitPacketBuffer() c=%u,s=%u\n", p->xcp_uncommited, p->xcp_size);
+            printf("CommitPacketBuffer() dlc=%u\n", p->dlc);
         }
 #endif   
 
-        mutexLock(&gXcpTl.Mutex_Queue);
-        p->xcp_uncommited--;
-        mutexUnlock(&gXcpTl.Mutex_Queue);
+        // Notify the transmit thread, when the last message of a completed buffer is commited
+        if (atomicAdd32(&b->xcp_commited, (uint32_t)p->dlc + XCPTL_TRANSPORT_LAYER_HEADER_SIZE) == atomicLoad32(&b->xcp_size)) notifyTransmitThread();
+    }
+}
+
+
+// Reserve space for count DTO packets in one DTO buffer with a single operation and return pointers to their data
+// All packets are transmitted in the same UDP packet
+// Returns 0, if the packets do not fit into one buffer or on overflow
+// Thread safe and lock free
+int udpTlGetPacketBuffers(void** par, unsigned int count, const uint16_t* sizes, unsigned char** data) {
+
+    tXcpDtoMessage* p;
+    uint64_t h;
+    unsigned int i, o;
+    unsigned int n = count * XCPTL_TRANSPORT_LAYER_HEADER_SIZE;
+
+    for (i = 0; i < count; i++) n += sizes[i];
+    if (n > gXcpTl.SlaveMTU) return 0; // Does not fit into any buffer
+
+    for (;;) {
+        h = atomicLoad64(&gXcpTl.dto_queue_head);
+        o = QUEUE_HEAD_OFFSET(h);
+        if (o + n <= gXcpTl.SlaveMTU) {
+            // Reserve space in the current buffer and get count DTO packet counters
+            if (atomicCas64(&gXcpTl.dto_queue_head, h, QUEUE_HEAD(QUEUE_HEAD_INDEX(h), o + n, QUEUE_HEAD_CTR(h) + count))) break;
+        }
+        else {
+            // Get another message buffer from queue, when active buffer ist full
+            if (!completeDtoBuffer(h)) return 0; // Overflow
+        }
+    }
+
+#if defined ( XCP_ENABLE_TESTMODE )
+    if (gDebugLevel >= 4) {
+        printf("GetPacketBuffers(%u,%u) buffer=%u, offset=%u, ctr=%u\n", count, n, QUEUE_HEAD_INDEX(h), o, QUEUE_HEAD_CTR(h));
+    }
+#endif
 
+    // Build XCP message headers (ctr+dlc) and store in DTO buffer
+    *((tXcpDtoMessage**)par) = (tXcpDtoMessage*)&gXcpTl.dto_queue[QUEUE_HEAD_INDEX(h)].xcp[o];
+    for (i = 0; i < count; i++) {
+        p = (tXcpDtoMessage*)&gXcpTl.dto_queue[QUEUE_HEAD_INDEX(h)].xcp[o];
+        p->ctr = (uint16_t)(QUEUE_HEAD_CTR(h) + i);
+        p->dlc = sizes[i];
+        data[i] = &p->data[0];
+        o += XCPTL_TRANSPORT_LAYER_HEADER_SIZE + sizes[i];
     }
+    return 1;
+}
+
+// Commit count DTO packets with size overall data bytes reserved by udpTlGetPacketBuffers
+// Thread safe and lock free
+void udpTlCommitPacketBuffers(void* par, unsigned int count, unsigned int size) {
+
+    tXcpDtoBuffer* b = &gXcpTl.dto_queue[((unsigned char*)par - (unsigned char*)&gXcpTl.dto_queue[0]) / sizeof(tXcpDtoBuffer)];
+
+    // Notify the transmit thread, when the last message of a completed buffer is commited
+    if (atomicAdd32(&b->xcp_commited, size + count * XCPTL_TRANSPORT_LAYER_HEADER_SIZE) == atomicLoad32(&b->xcp_size)) notifyTransmitThread();
 }
 
 
@@ -241,7 +1081,7 @@ int udpTlSendCrmPacket(const unsigned char* packet, unsigned int size) {
 
     // Build XCP CTO message (ctr+dlc+packet)
     tXcpCtoMessage p;
-    p.ctr = gXcpTl.LastCroCtr++;
+    p.ctr = (uint16_t)(atomicAdd32(&gXcpTl.LastCroCtr, 1) - 1); // Sent concurrently by the CMD thread and the command worker thread
     p.dlc = (uint16_t)size;
     memcpy(p.data, packet, size);
     do {
@@ -347,6 +1187,79 @@ static int udpTlHandleXcpCommands(int n, tXcpCtoMessage * p, tUdpSockAddr * src)
 
 // Handle incoming XCP commands
 // returns 0 on error
+#ifdef XCPTL_ENABLE_TCP
+
+// Receive exactly size bytes from the TCP connection
+// Returns 1 ok, 0 connection closed, -1 error
+static int tcpRecv(uint8_t* buffer, unsigned int size) {
+
+    unsigned int i = 0;
+    int r;
+
+    while (i < size) {
+        r = (int)recv(gXcpTl.Sock.sock, (char*)buffer + i, size - i, 0);
+        if (r == 0) return 0; // Closed
+        if (r < 0) {
+            if (socketGetLastError() == SOCKET_ERROR_CLOSED) return 0; // Closed
+            printf("ERROR %u: recv failed (result=%d)!\n", socketGetLastError(), r);
+            return -1; // Error
+        }
+        i += (unsigned int)r;
+    }
+    return 1;
+}
+
+// Accept a TCP connection from the master or receive and handle a XCP command message (length+counter header)
+// Blocking
+static int tcpHandleCommands() {
+
+    tXcpCtoMessage msg;
+    tUdpSockAddr src;
+    SOCKET sock;
+    int r;
+
+    // Wait for a master to connect
+    if (gXcpTl.Sock.sock == INVALID_SOCKET) {
+        sock = socketAccept(gXcpTl.ListenSock, &src.addr);
+        if (sock == INVALID_SOCKET) {
+            printf("ERROR %u: accept failed!\n", socketGetLastError());
+            return 0; // Error
+        }
+        tcpSetOptions(sock);
+        gXcpTl.TcpPeerAddr = src;
+        gXcpTl.Sock.sock = sock;
+        {
+            char tmp[32];
+            inet_ntop(AF_INET, &src.addr.sin_addr, tmp, sizeof(tmp));
+            printf("TCP connection accepted: addr=%s, port=%u\n", tmp, htons(src.addr.sin_port));
+        }
+        return 1;
+    }
+
+    // Receive a XCP message
+    r = tcpRecv((uint8_t*)&msg, XCPTL_TRANSPORT_LAYER_HEADER_SIZE);
+    if (r > 0 && (msg.dlc == 0 || msg.dlc > XCPTL_CTO_SIZE)) {
+        printf("ERROR: invalid XCP message length %u!\n", msg.dlc);
+        r = -1;
+    }
+    if (r > 0) r = tcpRecv(msg.data, msg.dlc);
+
+    // Connection closed or error, disconnect and wait for a new connection
+    if (r <= 0) {
+        printf("TCP connection closed\n");
+        if (XcpIsConnected()) XcpDisconnect();
+        mutexLock(&gXcpTl.Mutex_Send);
+        gXcpTl.MasterAddrValid = 0;
+        socketClose(&gXcpTl.Sock.sock);
+        mutexUnlock(&gXcpTl.Mutex_Send);
+        return 1;
+    }
+
+    return udpTlHandleXcpCommands(XCPTL_TRANSPORT_LAYER_HEADER_SIZE + msg.dlc, &msg, &gXcpTl.TcpPeerAddr);
+}
+
+#endif
+
 int udpTlHandleCommands() {
 
     uint8_t buffer[XCPTL_TRANSPORT_LAYER_HEADER_SIZE + XCPTL_CTO_SIZE];
@@ -354,6 +1267,10 @@ int udpTlHandleCommands() {
     socklen_t srclen;
     int n;
 
+#ifdef XCPTL_ENABLE_TCP
+    if (gOptionUseTCP) return tcpHandleCommands();
+#endif
+
     // Receive a UDP datagramm
     // No no partial messages assumed
 #ifdef APP_ENABLE_XLAPI_V3
@@ -419,7 +1336,7 @@ extern void* udpTlMulticastThread(void* par)
     uint8_t cip[4] = { 239,255,(uint8_t)(cid >> 8),(uint8_t)(cid) };
 
     printf("Start XCP multicast thread\n");
-    if (!socketOpen(&gXcpTl.MulticastSock, FALSE /*nonblocking*/, TRUE /*reusable*/)) return 0;
+    if (!socketOpen(&gXcpTl.MulticastSock, FALSE /*useTCP*/, FALSE /*nonblocking*/, TRUE /*reusable*/)) return 0;
     if (!socketBind(gXcpTl.MulticastSock, 5557)) return 0;
     if (!socketJoin(gXcpTl.MulticastSock, cip)) return 0;
     inet_ntop(AF_INET, cip, tmp, sizeof(tmp));
@@ -516,16 +1433,75 @@ int udpTlInit(uint8_t notUsedSlaveAddr1[4], uint16_t slavePort, uint16_t slaveMT
     gXcpTl.SlaveMTU = slaveMTU;
     if (gXcpTl.SlaveMTU > XCPTL_SOCKET_JUMBO_MTU_SIZE) gXcpTl.SlaveMTU = XCPTL_SOCKET_JUMBO_MTU_SIZE;
     gXcpTl.LastCroCtr = 0;
-    gXcpTl.DtoCtr = 0;
     gXcpTl.CrmCtr = 0;
     gXcpTl.MasterAddrValid = 0;
+    udpTlInitTransmitQueue();
+
+#ifdef XCPTL_ENABLE_TCP
+    if (gOptionUseTCP) {
+        gXcpTl.SlaveMTU = XCPTL_SOCKET_JUMBO_MTU_SIZE; // DTO buffer size, no IP fragmentation with TCP
+        gXcpTl.Sock.sock = INVALID_SOCKET; // No connection yet
+        if (!socketOpen(&gXcpTl.ListenSock, TRUE, FALSE, TRUE)) return 0;
+        if (!socketBind(gXcpTl.ListenSock, slavePort)) return 0;
+        if (!socketListen(gXcpTl.ListenSock)) return 0;
+        printf("  Listening on TCP port %u\n", slavePort);
+    }
+    else
+#endif
+    {
+        if (!socketOpen(&gXcpTl.Sock.sock, FALSE, FALSE, FALSE)) return 0;
+        if (!socketBind(gXcpTl.Sock.sock, slavePort)) return 0;
+        printf("  Listening on UDP port %u\n", slavePort);
+    }
 
-    if (!socketOpen(&gXcpTl.Sock.sock, FALSE, FALSE)) return 0;
-    if (!socketBind(gXcpTl.Sock.sock, slavePort)) return 0;
-    printf("  Listening on UDP port %u\n\n", slavePort);
+#ifdef XCPTL_ENABLE_UDP_GSO
+    // Check UDP generic segmentation offload support
+    {
+        int gsoSize = 0;
+        socklen_t l = sizeof(gsoSize);
+        gXcpTl.GsoEnabled = (getsockopt(gXcpTl.Sock.sock, SOL_UDP, UDP_SEGMENT, &gsoSize, &l) == 0);
+        printf("  UDP GSO %s\n", gXcpTl.GsoEnabled ? "enabled" : "not supported");
+    }
+#endif
+#ifdef XCPTL_ENABLE_ZEROCOPY
+    // Enable zero copy transmit
+    {
+        int one = 1;
+        gXcpTl.ZcEnabled = (setsockopt(gXcpTl.Sock.sock, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0);
+        gXcpTl.ZcNextId = gXcpTl.ZcSent = gXcpTl.ZcCompleted = gXcpTl.ZcCopied = 0;
+        printf("  Zero copy transmit %s\n", gXcpTl.ZcEnabled ? "enabled" : "not supported");
+    }
+#endif
+    printf("\n");
 
     mutexInit(&gXcpTl.Mutex_Send,FALSE,0);
-    mutexInit(&gXcpTl.Mutex_Queue,FALSE,1000);
+
+    // Transmit thread wakeup event
+    gXcpTl.TxWaiting = 0;
+    gXcpTl.TxEvent = eventfd(0, EFD_NONBLOCK);
+    if (gXcpTl.TxEvent < 0) {
+        printf("ERROR: eventfd failed (errno=%d)!\n", errno);
+        return 0;
+    }
+
+#ifdef XCPTL_ENABLE_IO_URING
+    // Init io_uring backend
+#ifdef XCPTL_ENABLE_TCP
+    if (gOptionUseIoUring && gOptionUseTCP) {
+        printf("WARNING: io_uring transport backend not supported for TCP!\n");
+        gOptionUseIoUring = FALSE;
+    }
+#endif
+    if (gOptionUseIoUring) {
+        if (uringInit()) {
+            printf("  Using io_uring transport backend\n");
+        }
+        else {
+            printf("WARNING: io_uring not supported, using socket transport backend!\n");
+            gOptionUseIoUring = FALSE;
+        }
+    }
+#endif
 
     // Create multicast thread
 #ifdef APP_ENABLE_MULTICAST
@@ -538,24 +1514,100 @@ int udpTlInit(uint8_t notUsedSlaveAddr1[4], uint16_t slavePort, uint16_t slaveMT
 }
 
 // Wait for outgoing data or timeout after timeout_us
+// Producers signal the event when a buffer is ready to send
 void udpTlWaitForTransmitData(unsigned int timeout_us) {
 
-    if (gXcpTl.dto_queue_len <= 1) {
-        sleepNs(timeout_us * 1000);
+    struct pollfd fds[2];
+    nfds_t n = 1;
+    struct timespec timeout;
+    uint64_t v;
+
+#ifdef XCPTL_DTO_QUEUE_FREE_INDEX
+    handleTransmitQueueReset();
+#endif
+    if (udpTlTransmitQueueHasData()) return;
+
+    // Announce waiting and check again, to avoid a lost wakeup
+    atomicStore32(&gXcpTl.TxWaiting, 1);
+    if (!udpTlTransmitQueueHasData()
+#ifdef XCPTL_DTO_QUEUE_FREE_INDEX
+        && !atomicLoad32(&gXcpTl.TxResetRequest)
+#endif
+        ) {
+        fds[0].fd = gXcpTl.TxEvent;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+#ifdef XCPTL_ENABLE_ZEROCOPY
+        // Zero copy completion notifications on the socket error queue (POLLERR) release pinned buffers
+        if (gXcpTl.dto_queue_fp != gXcpTl.dto_queue_rp) {
+            fds[1].fd = gXcpTl.Sock.sock;
+            fds[1].events = 0;
+            fds[1].revents = 0;
+            n = 2;
+        }
+#endif
+        timeout.tv_sec = timeout_us / 1000000;
+        timeout.tv_nsec = (timeout_us % 1000000) * 1000;
+        ppoll(fds, n, &timeout, NULL);
+    }
+    atomicStore32(&gXcpTl.TxWaiting, 0);
+    if (read(gXcpTl.TxEvent, &v, sizeof(v)) < 0) { /* Not signaled */ } // Reset the event counter
+#ifdef XCPTL_DTO_QUEUE_FREE_INDEX
+    handleTransmitQueueReset();
+#endif
+}
+
+#ifdef XCPTL_DTO_QUEUE_FREE_INDEX
+
+// Idle transmit thread, while DAQ is not running
+// Wait at most timeout_us for a transmit queue reset request and execute it
+void udpTlWaitForTransmitReset(unsigned int timeout_us) {
+
+    struct pollfd fd;
+    struct timespec timeout;
+    uint64_t v;
+
+    handleTransmitQueueReset();
+
+    // Announce waiting and check again, to avoid a lost wakeup
+    atomicStore32(&gXcpTl.TxWaiting, 1);
+    if (!atomicLoad32(&gXcpTl.TxResetRequest)) {
+        fd.fd = gXcpTl.TxEvent;
+        fd.events = POLLIN;
+        fd.revents = 0;
+        timeout.tv_sec = timeout_us / 1000000;
+        timeout.tv_nsec = (timeout_us % 1000000) * 1000;
+        ppoll(&fd, 1, &timeout, NULL);
     }
-    return; 
+    atomicStore32(&gXcpTl.TxWaiting, 0);
+    if (read(gXcpTl.TxEvent, &v, sizeof(v)) < 0) { /* Not signaled */ } // Reset the event counter
+    handleTransmitQueueReset();
 }
 
+#endif
+
 void udpTlShutdown() {
 
 #ifdef APP_ENABLE_MULTICAST
     socketClose(&gXcpTl.MulticastSock);
     sleepMs(500);
     cancel_thread(gXcpTl.MulticastThreadHandle);
+#endif
+#ifdef XCPTL_ENABLE_ZEROCOPY
+    if (gXcpTl.ZcEnabled) printZeroCopyStatistics();
+#endif
+#ifdef XCPTL_ENABLE_UDP_GSO
+    if (gXcpTl.GsoEnabled) printGsoStatistics();
+#endif
+#ifdef XCPTL_ENABLE_IO_URING
+    if (gOptionUseIoUring) uringShutdown();
 #endif
     mutexDestroy(&gXcpTl.Mutex_Send);
-    mutexDestroy(&gXcpTl.Mutex_Queue);
+    close(gXcpTl.TxEvent);
     socketClose(&gXcpTl.Sock.sock);
+#ifdef XCPTL_ENABLE_TCP
+    if (gOptionUseTCP) socketClose(&gXcpTl.ListenSock);
+#endif
 }
 
 
@@ -670,12 +1722,19 @@ int udpTlInit(uint8_t *slaveAddr, uint16_t slavePort, uint16_t slaveMTU) {
     gXcpTl.SlaveMTU = slaveMTU;
     if (gXcpTl.SlaveMTU > XCPTL_SOCKET_JUMBO_MTU_SIZE) gXcpTl.SlaveMTU = XCPTL_SOCKET_JUMBO_MTU_SIZE;
     gXcpTl.LastCroCtr = 0;
-    gXcpTl.DtoCtr = 0;
     gXcpTl.CrmCtr = 0;
     gXcpTl.MasterAddrValid = 0;
+    udpTlInitTransmitQueue();
 
     mutexInit(&gXcpTl.Mutex_Send,FALSE,0);
-    mutexInit(&gXcpTl.Mutex_Queue,FALSE,1000);
+
+    // Transmit thread wakeup event
+    gXcpTl.TxWaiting = 0;
+    gXcpTl.TxEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (gXcpTl.TxEvent == NULL) {
+        printf("ERROR: CreateEvent failed (error=%u)!\n", (uint32_t)GetLastError());
+        return 0;
+    }
 
 #ifdef APP_ENABLE_XLAPI_V3
     if (gOptionUseXLAPI) {     
@@ -692,27 +1751,43 @@ int udpTlInit(uint8_t *slaveAddr, uint16_t slavePort, uint16_t slaveMTU) {
 #endif
     }
     else 
+#endif
+#ifdef XCPTL_ENABLE_TCP
+    if (gOptionUseTCP) {
+        gXcpTl.SlaveMTU = XCPTL_SOCKET_JUMBO_MTU_SIZE; // DTO buffer size, no IP fragmentation with TCP
+        gXcpTl.Sock.sock = INVALID_SOCKET; // No connection yet
+        if (!socketOpen(&gXcpTl.ListenSock, TRUE, FALSE, TRUE)) return 0;
+        if (!socketBind(gXcpTl.ListenSock, slavePort)) return 0;
+        if (!socketListen(gXcpTl.ListenSock)) return 0;
+        printf("  Listening on TCP port %u\n\n", slavePort);
+    }
+    else
 #endif
     {            
-        if (!socketOpen(&gXcpTl.Sock.sock, FALSE, FALSE)) return 0;
+        if (!socketOpen(&gXcpTl.Sock.sock, FALSE, FALSE, FALSE)) return 0;
         if (!socketBind(gXcpTl.Sock.sock,slavePort)) return 0;
         printf("  Listening on UDP port %u\n\n", slavePort);
+    }
 #ifdef APP_ENABLE_MULTICAST
-        create_thread(&gXcpTl.MulticastThreadHandle, udpTlMulticastThread);
+    create_thread(&gXcpTl.MulticastThreadHandle, udpTlMulticastThread);
 #endif
-        return 1;
-    }
+    return 1;
 }
 
 
+// Wait for outgoing data or timeout after timeout_us
+// Producers signal the event when a buffer is ready to send
 void udpTlWaitForTransmitData(unsigned int timeout_us) {
 
-    if (gXcpTl.dto_queue_len <= 1) {
+    if (udpTlTransmitQueueHasData()) return;
+
+    // Announce waiting and check again, to avoid a lost wakeup
+    atomicStore32(&gXcpTl.TxWaiting, 1);
+    if (!udpTlTransmitQueueHasData()) {
         assert(timeout_us >= 1000);
-        Sleep(timeout_us/1000);
+        WaitForSingleObject(gXcpTl.TxEvent, timeout_us / 1000);
     }
-    return;
-
+    atomicStore32(&gXcpTl.TxWaiting, 0);
 }
 
 
@@ -731,7 +1806,11 @@ void udpTlShutdown() {
         cancel_thread(gXcpTl.MulticastThreadHandle);
 #endif
         socketClose(&gXcpTl.Sock.sock);
+#ifdef XCPTL_ENABLE_TCP
+        if (gOptionUseTCP) socketClose(&gXcpTl.ListenSock);
+#endif
     }
+    CloseHandle(gXcpTl.TxEvent);
 }
 
 #endif
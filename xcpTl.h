@@ -10,11 +10,23 @@
 extern "C" {
 #endif
 
+#ifndef _LINUX // Linux only transport layer options
+    #undef XCPTL_ENABLE_UDP_GSO
+    #undef XCPTL_ENABLE_ZEROCOPY
+    #undef XCPTL_ENABLE_IO_URING
+#endif
+
+// Sent DTO buffers may still be in use by the kernel, they are freed asynchronously 
+#if defined(XCPTL_ENABLE_ZEROCOPY) || defined(XCPTL_ENABLE_IO_URING)
+    #define XCPTL_DTO_QUEUE_FREE_INDEX
+#endif
+
 #ifdef _LINUX // Linux sockets
 
     #define RECV_FLAGS 0 // Blocking receive (no MSG_DONTWAIT)
     #define SENDTO_FLAGS 0 // Blocking transmit (no MSG_DONTWAIT)
     #define SEND_RETRIES 10 // Retry when send CRM would block
+    #define TCP_SEND_FLAGS MSG_NOSIGNAL // No SIGPIPE on lost connection
 
 
 #endif 
@@ -29,6 +41,7 @@ extern "C" {
     #define RECV_FLAGS 0
     #define SENDTO_FLAGS 0
     #define SEND_RETRIES 10 // Retry when send CRM would block
+    #define TCP_SEND_FLAGS 0
 
 #endif
 
@@ -46,8 +59,14 @@ typedef struct {
 
 
 typedef struct {
-    unsigned int xcp_size;             // Number of overall bytes in XCP DTO messages
-    unsigned int xcp_uncommited;       // Number of uncommited XCP DTO messages
+    volatile uint32_t xcp_size;        // Number of overall bytes in XCP DTO messages, 0 while the buffer is not complete
+    volatile uint32_t xcp_commited;    // Number of bytes in commited XCP DTO messages
+#ifdef XCPTL_DTO_QUEUE_FREE_INDEX
+    int released;                      // Sent and released by the kernel
+#endif
+#ifdef XCPTL_ENABLE_ZEROCOPY
+    uint32_t zc_id;                    // Zero copy notification id of the send
+#endif
     unsigned char xcp[XCPTL_SOCKET_JUMBO_MTU_SIZE]; // Contains concatenated messages
 } tXcpDtoBuffer;
 
@@ -66,6 +85,49 @@ typedef union {
 #endif
 } tUdpSock;
 
+#ifdef XCPTL_ENABLE_IO_URING
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+typedef struct {
+    int fd;
+    void* ring; // Submission and completion queue rings
+    size_t ring_size;
+    struct io_uring_sqe* sqes; // Submission queue entries
+    size_t sqes_size;
+
+    // Submission queue
+    volatile uint32_t* sq_head;
+    volatile uint32_t* sq_tail;
+    uint32_t* sq_array;
+    uint32_t sq_mask;
+    uint32_t sq_entries;
+    uint32_t sq_tail_local; // Tail including prepared but not yet submitted entries
+
+    // Completion queue
+    volatile uint32_t* cq_head;
+    volatile uint32_t* cq_tail;
+    uint32_t cq_mask;
+    struct io_uring_cqe* cqes;
+
+    // Receive operation
+    uint8_t rx_buffer[XCPTL_TRANSPORT_LAYER_HEADER_SIZE + XCPTL_CTO_SIZE];
+    struct msghdr rx_msg;
+    struct iovec rx_iov;
+    tUdpSockAddr rx_src;
+    int rx_len; // Length of the received and not yet handled CRO packet, -1 if none
+
+    // Send operations, indexed by DTO buffer
+    struct msghdr tx_msg[XCPTL_DTO_QUEUE_SIZE];
+    struct iovec tx_iov[XCPTL_DTO_QUEUE_SIZE];
+    unsigned int sends; // Send operations in flight
+
+    int event_armed; // Transmit event poll operation armed
+} tXcpTlUring;
+
+#endif
+
 typedef struct {
     
     tUdpSock Sock;
@@ -74,20 +136,33 @@ typedef struct {
     uint8_t SlaveUUID[8];
     tUdpSockAddr MasterAddr;
     int MasterAddrValid;
+#ifdef XCPTL_ENABLE_TCP
+    SOCKET ListenSock; // TCP listen socket, Sock is the connection socket
+    tUdpSockAddr TcpPeerAddr; // Address of the connected TCP peer
+#endif
 
     // Transmit queue 
+    // Lock free, multiple producers (XCP event threads) and a single consumer (DAQ thread)
     tXcpDtoBuffer dto_queue[XCPTL_DTO_QUEUE_SIZE];
-    unsigned int dto_queue_rp; // rp = read index
-    unsigned int dto_queue_len; // rp+len = write index (the next free entry), len=0 ist empty, len=XCPTL_DTO_QUEUE_SIZE is full
-    tXcpDtoBuffer* dto_buffer_ptr; // current incomplete or not fully commited entry
+    volatile uint32_t dto_queue_rp; // rp = read index (the oldest entry), written by the consumer only
+#ifdef XCPTL_DTO_QUEUE_FREE_INDEX
+    volatile uint32_t dto_queue_fp; // fp = free index, entries from fp to rp are sent but still in use by the kernel
+#endif
+    volatile uint64_t dto_queue_head; // Index of the current incomplete entry, write offset in this entry and next DTO packet counter, see QUEUE_HEAD()
+#ifdef XCPTL_ENABLE_UDP_GSO
+    int GsoEnabled; // UDP generic segmentation offload supported
+    uint32_t GsoMessages, GsoFrames, GsoFill; // Statistics, UDP messages sent, UDP frames in these messages, fill bytes appended to frames
+#endif
+#ifdef XCPTL_ENABLE_ZEROCOPY
+    int ZcEnabled; // Zero copy transmit (MSG_ZEROCOPY) supported
+    uint32_t ZcNextId; // Notification id of the next zero copy send
+    uint32_t ZcSent, ZcCompleted, ZcCopied; // Statistics, sends completed without zero copy are counted as copied
+#endif
 
     // CTO command transfer object counters (CRM,CRO)
-    uint16_t LastCroCtr; // Last CRO command receive object message packet counter received
+    volatile uint32_t LastCroCtr; // CRM packet counter, CRM packets are sent by the CMD thread and the command worker thread
     uint16_t CrmCtr; // next CRM command response message packet counter
 
-    // DTO data transfer object counter (DAQ,STIM)
-    uint16_t DtoCtr; // next DAQ DTO data transmit message packet counter 
-
     // Multicast
 #ifdef APP_ENABLE_MULTICAST
     tXcpThread MulticastThreadHandle;
@@ -98,8 +173,25 @@ typedef struct {
     #endif
 #endif 
 
-    MUTEX Mutex_Queue;
     MUTEX Mutex_Send;
+
+    // Transmit thread wakeup
+    volatile uint32_t TxWaiting; // Transmit thread is waiting for TxEvent
+#ifdef _LINUX
+    int TxEvent; // eventfd
+#else
+    HANDLE TxEvent;
+#endif
+#ifdef XCPTL_DTO_QUEUE_FREE_INDEX
+    // Transmit queue reset, executed by the transmit thread, which also handles the buffer release notifications of the kernel
+    volatile uint32_t TxResetRequest; // 0 = none, 1 = requested, 2 = in progress
+    pthread_t TxThread; // Thread handling the transmit queue, valid if TxThreadValid
+    volatile uint32_t TxThreadValid;
+#endif
+
+#ifdef XCPTL_ENABLE_IO_URING
+    tXcpTlUring Uring;
+#endif
        
 } tXcpTlData;
 
@@ -116,10 +208,19 @@ extern int udpTlSendCrmPacket(const uint8_t* data, unsigned int n);
 
 extern uint8_t* udpTlGetPacketBuffer(void** par, unsigned int size);
 extern void udpTlCommitPacketBuffer(void* par);
+extern int udpTlGetPacketBuffers(void** par, unsigned int count, const uint16_t* sizes, uint8_t** data);
+extern void udpTlCommitPacketBuffers(void* par, unsigned int count, unsigned int size);
 extern void udpTlFlushTransmitQueue();
 extern int udpTlHandleTransmitQueue();
 extern void udpTlInitTransmitQueue();
 extern void udpTlWaitForTransmitData(unsigned int timeout_us);
+#ifdef XCPTL_DTO_QUEUE_FREE_INDEX
+extern void udpTlWaitForTransmitReset(unsigned int timeout_us);
+#endif
+
+#ifdef XCPTL_ENABLE_IO_URING
+extern int udpTlHandleIoUring(unsigned int timeout_us);
+#endif
 
 #ifdef __cplusplus
 }
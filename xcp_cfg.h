@@ -39,6 +39,9 @@ typedef uint8_t  vbool;
 // Enable debug print (ApplXcpPrint)
 #define XCP_ENABLE_TESTMODE 
 
+// Enable the DAQ sampling and checksum benchmarks (main options -daqbench and -csbench)
+#define XCP_ENABLE_BENCHMARK
+
 
  /*----------------------------------------------------------------------------*/
  /* Version */
@@ -61,10 +64,39 @@ typedef uint8_t  vbool;
 #define XCP_ENABLE_DAQ_EVENT_LIST // Enable event list
 #define XCP_MAX_EVENT 256 // Maximum number of events, size of event table
 
+#define XCP_ENABLE_DAQ_PRESCALER // Enable the DAQ list prescaler of SET_DAQ_LIST_MODE
+#define XCP_ENABLE_DAQ_ON_CHANGE // Enable USER_CMD SET_DAQ_LIST_ON_CHANGE, DAQ lists transmitted only when their data changed
+#define XCP_ENABLE_DAQ_GATHER // Compile runs of scattered 4 byte ODT entries into gather operations, executed with AVX2 if the CPU supports it
+#define XCP_DAQ_GATHER_MIN 8 // Minimum number of scattered 4 byte ODT entries for a gather operation
+
+// #define XCP_ENABLE_DAQ_RECORDER // Record the DTO stream into a ring buffer, transmit the pre-trigger history on trigger
+#define XCP_REC_BUFFER_SIZE (16*1024*1024) // Ring buffer size in bytes, limits the pre-trigger depth
+#define XCP_REC_DEPTH_MS 0 // Default pre-trigger depth in ms, 0 = limited by the ring buffer size only
+
+// #define XCP_ENABLE_MDF_RECORDER // Record the signals of the A2L generator to a local MDF4 file without XCP master, Linux only
+#define XCP_MDF_MAX_SIGNALS 1024 // Maximum number of recorded signals
+#define XCP_MDF_SLOT_COUNT (4*1024) // DTO message slots in the ring between XcpEvent and the writer thread
+#define XCP_MDF_BLOCK_SIZE (1024*1024) // Size of the aligned file writes, multiple of 4096
+#define XCP_MDF_POLL_CYCLE_MS 2 // Writer thread polling cycle
+
+#define XCP_ENABLE_BLOCK_MODE // Enable slave block mode for UPLOAD and master block mode for DOWNLOAD with DOWNLOAD_NEXT
+#define XCP_MIN_ST 0 // Master block mode minimum separation time between DOWNLOAD_NEXT packets in 100us units
+
+#define XCP_ENABLE_CMD_QUEUE // Execute long running commands and the commands queued behind them in a command worker thread, SYNC and GET_DAQ_CLOCK are answered immediately
+#define XCP_CMD_QUEUE_SIZE 16 // Maximum number of queued commands
+#define XCP_CMD_QUEUE_WAIT_MS 100 // Maximum wait of the command worker thread, it is woken up when a command is queued
+
 #ifdef APP_ENABLE_CAL_SEGMENT
   #define XCP_ENABLE_CHECKSUM // Enable checksum calculation command
+  #define XCP_CHECKSUM_TYPE XCP_CHECKSUM_TYPE_ADD44 // BUILD_CHECKSUM type, XCP_CHECKSUM_TYPE_ADD44, _ADD14, _CRC16CCITT or _CRC32
   #define XCP_ENABLE_CAL_PAGE // Enable cal page switching co
+  #define XCP_CAL_DELTA_LOG_SIZE 256 // Modified address ranges of the working page tracked for publishing, the whole page is copied on overflow
+  #define XCP_ENABLE_CAL_STORE // Persist the published calibration in a memory mapped file, restored on startup, STORE_CAL_REQ
 #endif
+#define XCP_CAL_STORE_FILE "xcplite.cal" // Calibration store file
+#define XCP_CAL_STORE_MAX_SEGMENTS 4 // Maximum number of memory ranges registered for the calibration store
+#define XCP_CAL_STORE_DELAY_MS 500 // Modifications are written after this time without further modifications or immediately on STORE_CAL_REQ
+#define XCP_CAL_STORE_POLL_CYCLE_MS 10 // Calibration store thread polling cycle
 
 #define XCP_ENABLE_FILE_UPLOAD // Enable GET_ID A2L content upload to host
 #define XCP_ENABLE_A2L_NAME // Enable GET_ID A2L name upload to host
@@ -78,7 +110,14 @@ typedef uint8_t  vbool;
 /*----------------------------------------------------------------------------*/
 /* Settings and parameters */
 
-#define XCP_DAQ_MEM_SIZE (5*10000) // Amount of memory for DAQ tables, each ODT entry needs 5 bytes
+#define XCP_ENABLE_DYNAMIC_DAQ_MEM // Allocate the DAQ memory from the heap on demand with ALLOC_DAQ, ALLOC_ODT and ALLOC_ODT_ENTRY
+#ifdef XCP_ENABLE_DYNAMIC_DAQ_MEM
+  #define XCP_DAQ_MEM_SIZE (4*1024*1024) // Upper limit for the DAQ memory, each ODT entry needs 5 bytes plus 8 bytes copy plan
+#else
+  #define XCP_DAQ_MEM_SIZE (5*10000) // Amount of memory for DAQ tables, each ODT entry needs 5 bytes
+#endif
+//#define XCP_ENABLE_DAQ_HDR_ODT_FIL_DAQW // Use a 4 byte ODT,FIL,DAQW DTO header to support more than 255 DAQ lists, default is the 2 byte ODT,DAQB header
+#define XCP_MAX_EVENT_ODT 32 // Maximum number of ODTs of an event reserved in the transport layer with a single operation, events with more ODTs reserve each ODT separately
 
 
 #ifdef CLOCK_USE_UTC_TIME_NS  // Clock type defined in main.h
@@ -25,6 +25,35 @@
  // DTO queue entry count 
 #define XCPTL_DTO_QUEUE_SIZE 100   // DAQ transmit queue size in UDP packets, should at least be able to hold all data produced until the next call to udpTlHandleTransmitQueue
 
+// XCP on TCP (selected at runtime with gOptionUseTCP)
+#define XCPTL_ENABLE_TCP
+#define XCPTL_TCP_NODELAY 1 // Disable Nagle algorithm
+#define XCPTL_TCP_SOCKET_BUFFER_SIZE (4*1024*1024) // TCP socket send and receive buffer size
+
+// XCP on shared memory for masters on the same host (Linux only)
+// Replaces the UDP/TCP transport layer, DTO packets are written directly into a memory mapped ring
+//#define XCPTL_ENABLE_SHM
+#define XCPTL_SHM_NAME "/XCPlite" // Shared memory object name
+#define XCPTL_SHM_SLOT_COUNT 4096 // Packet ring size in XCP packets
+
+// DTO transmit batch size (Linux only)
+#define XCPTL_SEND_BATCH_SIZE 32   // Maximum number of UDP packets handed to the kernel with a single sendmmsg call, 1 = use sendto for each packet
+
+// UDP generic segmentation offload (Linux only)
+// Consecutive DTO buffers of equal size are sent as one large UDP message, which is split into UDP packets by the kernel or NIC
+//#define XCPTL_ENABLE_UDP_GSO
+#define XCPTL_GSO_MAX_SEGMENTS 64  // Maximum number of UDP packets in one message (kernel limit UDP_MAX_SEGMENTS)
+#define XCPTL_GSO_MAX_SIZE 65000   // Maximum size of one message
+
+// Zero copy DTO transmit with MSG_ZEROCOPY (Linux only)
+// Sent DTO buffers stay pinned until the kernel notifies completion, the queue size should be increased accordingly
+//#define XCPTL_ENABLE_ZEROCOPY
+
+// io_uring transport backend (Linux only, selected at runtime with gOptionUseIoUring)
+// Command receive and DTO transmit are handled by a single thread
+//#define XCPTL_ENABLE_IO_URING
+#define XCPTL_IO_URING_ENTRIES 128 // Submission queue size, must be larger than XCPTL_DTO_QUEUE_SIZE
+
 
 #endif
 